@@ -0,0 +1,126 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "instrumentation.hpp"
+
+// Replaces the global allocation functions, so that every pass can report
+// how often it went to the heap through thread_allocation_count.
+// Only the programs which want those counts link this file;
+// the library itself leaves the allocator alone.
+//
+// Every form is replaced here, as the standard library does not promise
+// that the array or aligned forms go through the plain ones.
+
+namespace {
+    void * counted_allocation(size_t size) noexcept {
+        count_allocation(size);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    // malloc only aligns for the fundamental types, so the block is
+    // made bigger, lined up by hand, and the start of the malloc block
+    // is kept just before the aligned one for aligned_free
+    void * aligned_allocation(size_t size, std::align_val_t align) noexcept {
+        count_allocation(size);
+        const auto alignment = static_cast<size_t>(align);
+
+        auto * block = static_cast<char *>(
+            std::malloc(size + alignment + sizeof(void *)));
+        if (block == nullptr) return nullptr;
+
+        const auto address
+            = (reinterpret_cast<std::uintptr_t>(block + sizeof(void *))
+               + alignment - 1)
+            & ~std::uintptr_t{alignment - 1};
+        auto * to_ret = reinterpret_cast<void *>(address);
+        static_cast<void **>(to_ret)[-1] = block;
+        return to_ret;
+    }
+
+    void aligned_free(void * ptr) noexcept {
+        if (ptr != nullptr) std::free(static_cast<void **>(ptr)[-1]);
+    }
+
+    template<typename allocate_t>
+    void * throwing(allocate_t && allocate) {
+        if (auto * to_ret = allocate(); to_ret != nullptr) return to_ret;
+        throw std::bad_alloc{};
+    }
+}  // namespace
+
+void * operator new(size_t size) {
+    return throwing([size] { return counted_allocation(size); });
+}
+
+void * operator new[](size_t size) {
+    return throwing([size] { return counted_allocation(size); });
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+    return counted_allocation(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return counted_allocation(size);
+}
+
+void * operator new(size_t size, std::align_val_t align) {
+    return throwing([=] { return aligned_allocation(size, align); });
+}
+
+void * operator new[](size_t size, std::align_val_t align) {
+    return throwing([=] { return aligned_allocation(size, align); });
+}
+
+void * operator new(size_t size, std::align_val_t align,
+                    const std::nothrow_t &) noexcept {
+    return aligned_allocation(size, align);
+}
+
+void * operator new[](size_t size, std::align_val_t align,
+                      const std::nothrow_t &) noexcept {
+    return aligned_allocation(size, align);
+}
+
+void operator delete(void * ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void * ptr) noexcept { std::free(ptr); }
+
+void operator delete(void * ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void * ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete(void * ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void * ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, std::align_val_t) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete[](void * ptr, std::align_val_t) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete(void * ptr, size_t, std::align_val_t) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete[](void * ptr, size_t, std::align_val_t) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete(void * ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete[](void * ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+    aligned_free(ptr);
+}
@@ -0,0 +1,323 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "grammar.hpp"
+#include "grammar_generator.hpp"
+#include "grammar_transform.hpp"
+#include "instrumentation.hpp"
+#include "ll1.hpp"
+#include "pass_context.hpp"
+#include "recognizer.hpp"
+#include "thread_pool.hpp"
+
+// Benchmarks for the grammar library.
+// Each benchmark is run over a sweep of sizes, so that scaling problems
+// show up as numbers rather than as a vague feeling of slowness.
+
+namespace {
+    // The library's progress messages are not part of the timing
+    diagnostics  quiet{log_level::quiet};
+    pass_context quiet_context{quiet};
+
+    // Heap allocations so far, including those of the --jobs workers
+    size_t allocation_count() {
+        return thread_allocation_count()
+             + (quiet_context.pool != nullptr
+                    ? quiet_context.pool->worker_allocation_count()
+                    : 0);
+    }
+
+    template<typename func_t>
+    double time_ms(func_t && func) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // One line of the CSV output.
+    // The sizes are bytes for the parsers and tokens for the transforms;
+    // write_text goes from tokens to bytes, ll1_table to table entries,
+    // and recognize from terminals to strings accepted.
+    struct measurement {
+        const char * name;
+        size_t       input_size;
+        size_t       output_size;
+        size_t       allocations;
+        double       milliseconds;
+        bool         failed;
+    };
+
+    void report(size_t nonterminal_count, const measurement & result) {
+        std::cout << result.name << ',' << nonterminal_count << ','
+                  << result.input_size << ',' << result.output_size << ','
+                  << result.allocations << ',' << result.milliseconds
+                  << (result.failed ? ",failed" : "") << '\n';
+    }
+
+    // Times `parse`, which must return an optional grammar
+    template<typename parse_t>
+    std::optional<grammar> bench_parse(const char * name, size_t input_size,
+                                       size_t nonterminal_count,
+                                       parse_t && parse) {
+        std::optional<grammar> parsed;
+
+        const auto allocations = allocation_count();
+        const auto elapsed     = time_ms([&] { parsed = parse(); });
+
+        report(nonterminal_count,
+               {name, input_size,
+                parsed ? grammar_size::of(*parsed).tokens : 0,
+                allocation_count() - allocations, elapsed,
+                not parsed});
+        return parsed;
+    }
+
+    // Times `transform`, which must take a grammar
+    // and return a grammar or an optional grammar
+    template<typename transform_t>
+    auto bench_transform(const char * name, const grammar & input,
+                         size_t nonterminal_count, transform_t && transform) {
+        // The transforms edit their input, so it is copied before timing
+        auto copy = input;
+
+        const auto allocations = allocation_count();
+        const auto start       = std::chrono::steady_clock::now();
+        auto       output      = transform(std::move(copy));
+        const auto end         = std::chrono::steady_clock::now();
+
+        const grammar * result = nullptr;
+        if constexpr (std::is_same_v<decltype(output), grammar>)
+            result = &output;
+        else if (output)
+            result = &*output;
+
+        report(nonterminal_count,
+               {name, grammar_size::of(input).tokens,
+                result != nullptr ? grammar_size::of(*result).tokens : 0,
+                allocation_count() - allocations,
+                std::chrono::duration<double, std::milli>(end - start).count(),
+                result == nullptr});
+        return output;
+    }
+
+    // Times recognizing strings derived from `source` with `input`,
+    // which must have the same language
+    void bench_recognize(const grammar & source, const grammar & input,
+                         size_t nonterminal_count, std::uint32_t seed) {
+        const auto sentences = generate_sentences(source, 256, 64, seed);
+
+        size_t terminals = 0;
+        for (const auto & sentence : sentences) terminals += sentence.size();
+
+        recognizer parser{input};
+        size_t     accepted    = 0;
+        const auto allocations = allocation_count();
+        const auto elapsed     = time_ms([&] {
+            for (const auto & sentence : sentences)
+                if (parser.accepts(sentence)) ++accepted;
+        });
+        report(nonterminal_count,
+               {"recognize", terminals, accepted,
+                allocation_count() - allocations, elapsed,
+                accepted != sentences.size()});
+    }
+
+    void bench_size(grammar_shape shape, size_t nonterminal_count) {
+        shape.nonterminal_count = nonterminal_count;
+        const auto data         = generate_grammar(shape);
+
+        const auto parsed
+            = bench_parse("parse", data.size(), nonterminal_count, [&] {
+                  return grammar::parse_from_file(data, quiet);
+              });
+
+        std::istringstream stream{data};
+        bench_parse("parse_stream", data.size(), nonterminal_count, [&] {
+            return grammar::parse_from_stream(stream, quiet);
+        });
+
+        if (not parsed) return;
+
+        std::ostringstream binary{};
+        parsed->write_binary(binary);
+        const auto binary_data = binary.str();
+        bench_parse("parse_binary", binary_data.size(), nonterminal_count, [&] {
+            return grammar::parse_binary(binary_data, quiet);
+        });
+
+        std::ostringstream text{};
+        const auto         text_allocations = allocation_count();
+        const auto elapsed = time_ms([&] { parsed->write_text(text); });
+        report(nonterminal_count,
+               {"write_text", grammar_size::of(*parsed).tokens,
+                text.str().size(),
+                allocation_count() - text_allocations, elapsed,
+                false});
+
+        // Each transform is timed on its own, on the input it sees
+        // as part of make_proper_form
+        const auto without_epsilon = bench_transform(
+            "remove_epsilon", *parsed, nonterminal_count, [](grammar input) {
+                return remove_epsilon(std::move(input), quiet_context);
+            });
+
+        const auto without_units = bench_transform(
+            "remove_unit_productions", without_epsilon, nonterminal_count,
+            [](grammar input) {
+                return remove_unit_productions(std::move(input),
+                                               quiet_context);
+            });
+
+        bench_transform(
+            "remove_unreachables", without_units, nonterminal_count,
+            [](grammar input) {
+                return remove_unreachables(std::move(input), quiet_context);
+            });
+
+        bench_transform(
+            "remove_useless", without_units, nonterminal_count,
+            [](grammar input) {
+                return remove_useless(std::move(input), quiet_context);
+            });
+
+        const auto proper = bench_transform(
+            "make_proper_form", *parsed, nonterminal_count, [](grammar input) {
+                return make_proper_form(std::move(input), quiet_context);
+            });
+
+        const auto without_recursion = bench_transform(
+            "remove_left_recursion", proper, nonterminal_count,
+            [](grammar input) {
+                return remove_left_recursion(std::move(input), quiet_context);
+            });
+
+        if (without_recursion)
+            bench_transform("left_factor", *without_recursion,
+                            nonterminal_count, [](grammar input) {
+                                return left_factor(std::move(input),
+                                                   quiet_context);
+                            });
+
+        const auto cleaned = bench_transform(
+            "remove_left_recursion_by_components", proper, nonterminal_count,
+            [](grammar input) {
+                return remove_left_recursion_by_components(std::move(input),
+                                                           quiet_context);
+            });
+
+        // What an LL parser generator would make of the result
+        if (cleaned) {
+            size_t     entries           = 0;
+            const auto table_allocations = allocation_count();
+            const auto table_elapsed     = time_ms([&] {
+                const ll1_sets  sets{*cleaned};
+                const ll1_table table{*cleaned, sets};
+                entries = table.entry_count();
+            });
+            report(nonterminal_count,
+                   {"ll1_table", grammar_size::of(*cleaned).tokens, entries,
+                    allocation_count() - table_allocations,
+                    table_elapsed, false});
+
+            bench_recognize(proper, *cleaned, nonterminal_count, shape.seed);
+        }
+
+        // An unchanged grammar, so every result comes from the cache
+        left_recursion_cache cache{};
+        static_cast<void>(remove_left_recursion(proper, cache, quiet_context));
+        bench_transform("remove_left_recursion_cached", proper,
+                        nonterminal_count, [&cache](grammar input) {
+                            return remove_left_recursion(std::move(input),
+                                                         cache, quiet_context);
+                        });
+    }
+
+    void print_usage(const char * program_name) {
+        const grammar_shape defaults{};
+        std::cerr
+            << program_name << " [options] [sizes...]\n"
+            << "Benchmarks every transform on generated grammars with the "
+               "given numbers of nonterminals\n"
+            << "Options:\n"
+            << "\t--alternatives <n> -> ordinary alternatives per rule ("
+            << defaults.alternatives << ")\n"
+            << "\t--rule-length <n> -> symbols per alternative ("
+            << defaults.rule_length << ")\n"
+            << "\t--left-recursion <fraction> -> nonterminals which are "
+               "indirectly left recursive ("
+            << defaults.left_recursion << ")\n"
+            << "\t--nullable <fraction> -> nonterminals with an empty "
+               "alternative ("
+            << defaults.nullable << ")\n"
+            << "\t--unit-depth <n> -> length of unit production chains ("
+            << defaults.unit_chain_depth << ")\n"
+            << "\t--seed <n> -> seed of the generator (" << defaults.seed
+            << ")\n"
+            << "\t--jobs <n> -> threads for the transforms, 0 for all cores "
+               "(1)\n";
+    }
+}  // namespace
+
+int main(int arg_count, const char ** args) {
+    grammar_shape       shape{};
+    std::vector<size_t> sizes;
+    size_t              jobs = 1;
+
+    for (int arg_num = 1; arg_num < arg_count; ++arg_num) {
+        const std::string_view arg{args[arg_num]};
+
+        if (arg.size() < 2 or arg.substr(0, 2) != "--") {
+            sizes.push_back(std::strtoul(args[arg_num], nullptr, 10));
+            continue;
+        }
+
+        if (arg == "--help") {
+            print_usage(args[0]);
+            return 0;
+        }
+
+        if (++arg_num == arg_count) {
+            print_usage(args[0]);
+            return 1;
+        }
+
+        const char * value = args[arg_num];
+        if (arg == "--alternatives")
+            shape.alternatives = std::strtoul(value, nullptr, 10);
+        else if (arg == "--rule-length")
+            shape.rule_length = std::strtoul(value, nullptr, 10);
+        else if (arg == "--left-recursion")
+            shape.left_recursion = std::strtod(value, nullptr);
+        else if (arg == "--nullable")
+            shape.nullable = std::strtod(value, nullptr);
+        else if (arg == "--unit-depth")
+            shape.unit_chain_depth = std::strtoul(value, nullptr, 10);
+        else if (arg == "--seed")
+            shape.seed = std::strtoul(value, nullptr, 10);
+        else if (arg == "--jobs")
+            jobs = std::strtoul(value, nullptr, 10);
+        else {
+            print_usage(args[0]);
+            return 1;
+        }
+    }
+    if (sizes.empty()) sizes = {1000, 2000, 4000, 8000};
+
+    std::optional<thread_pool> pool{};
+    if (jobs != 1) quiet_context.pool = &pool.emplace(jobs);
+
+    std::cout << "benchmark,nonterminals,input_size,output_size,allocations,"
+                 "milliseconds\n";
+    for (const auto size : sizes) bench_size(shape, size);
+}
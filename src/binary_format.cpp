@@ -0,0 +1,219 @@
+#include "binary_format.hpp"
+
+#include <cstdlib>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "grammar.hpp"
+
+using token_t       = grammar::token_t;
+using symbol_t      = grammar::symbol_t;
+using productions_t = grammar::productions_t;
+
+namespace {
+    constexpr size_t field_size = 4;
+
+    void put(std::string & buffer, std::uint32_t value) {
+        for (unsigned byte = 0; byte < field_size; ++byte)
+            buffer += static_cast<char>((value >> (8 * byte)) & 0xffu);
+    }
+
+    void put_token(std::string & buffer, token_t token) {
+        put(buffer, static_cast<std::uint32_t>(static_cast<int>(token)));
+    }
+
+    [[nodiscard]] std::uint32_t get(const char * data) {
+        std::uint32_t to_ret = 0;
+        for (unsigned byte = 0; byte < field_size; ++byte)
+            to_ret |= static_cast<std::uint32_t>(
+                          static_cast<unsigned char>(data[byte]))
+                      << (8 * byte);
+        return to_ret;
+    }
+
+    [[nodiscard]] token_t get_token(const char * data) {
+        return token_t{static_cast<std::int32_t>(get(data))};
+    }
+}  // namespace
+
+void grammar::write_binary(std::ostream & out) const {
+    using namespace binary_format;
+
+    std::vector<std::pair<token_t, const symbol_t *>> entries{};
+    size_t                                            name_total = 0;
+    symbols.for_each([&](token_t token, const symbol_t & symbol) {
+        // Every grammar starts out with the rule separator
+        if (token == rule_sep) return;
+        entries.emplace_back(token, &symbol);
+        name_total += static_cast<const std::string &>(symbol).size();
+    });
+
+    size_t alternative_total = 0;
+    size_t token_total       = 0;
+    for (const auto & entry : rules) {
+        alternative_total += entry.second.size();
+        token_total += entry.second.token_count();
+    }
+
+    std::string buffer{};
+    buffer.reserve(field_size
+                       * (header_fields + symbol_fields * entries.size()
+                          + rule_fields * rules.size() + alternative_total
+                          + token_total)
+                   + name_total);
+
+    put(buffer, magic);
+    put(buffer, version);
+    put(buffer, static_cast<std::uint32_t>(entries.size()));
+    put(buffer, static_cast<std::uint32_t>(rules.size()));
+    put(buffer, static_cast<std::uint32_t>(alternative_total));
+    put(buffer, static_cast<std::uint32_t>(token_total));
+    put(buffer, static_cast<std::uint32_t>(name_total));
+
+    std::uint32_t name_offset = 0;
+    for (const auto & [token, symbol] : entries) {
+        const auto length = static_cast<std::uint32_t>(
+            static_cast<const std::string &>(*symbol).size());
+        put_token(buffer, token);
+        put(buffer, name_offset);
+        put(buffer, length);
+        name_offset += length;
+    }
+
+    for (const auto & [nonterm, alternatives] : rules) {
+        put_token(buffer, nonterm);
+        put(buffer, static_cast<std::uint32_t>(alternatives.size()));
+    }
+
+    std::uint32_t token_end = 0;
+    for (const auto & entry : rules)
+        for (const auto alternative : entry.second) {
+            token_end += static_cast<std::uint32_t>(alternative.size());
+            put(buffer, token_end);
+        }
+
+    for (const auto & entry : rules)
+        for (const auto token : entry.second.all_tokens())
+            put_token(buffer, token);
+
+    for (const auto & [token, symbol] : entries)
+        buffer += static_cast<const std::string &>(*symbol);
+
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+std::optional<grammar> grammar::parse_binary(std::string_view data,
+                                             diagnostics &    diag) {
+    using namespace binary_format;
+
+    const auto invalid = [&diag](const char * reason) {
+        diag.error("Not a valid binary grammar: ", reason, '\n');
+        return std::optional<grammar>{};
+    };
+
+    if (data.size() < field_size * header_fields)
+        return invalid("too short for the header");
+
+    const auto header = [&data](header_field field) -> size_t {
+        return get(data.data() + field_size * field);
+    };
+
+    if (header(magic_field) != magic) return invalid("wrong magic number");
+    if (header(version_field) != version) {
+        diag.error("Binary grammar has version ", header(version_field),
+                   ", but only version ", version, " is supported\n");
+        return std::optional<grammar>{};
+    }
+
+    // Every count is at most 2^32, so none of these can overflow
+    const auto symbol_total      = header(symbol_count);
+    const auto rule_total        = header(rule_count);
+    const auto alternative_total = header(alternative_count);
+    const auto token_total       = header(token_count);
+    const auto name_total        = header(name_bytes);
+
+    // The sections are measured before any of them is looked at
+    const size_t symbol_start = field_size * header_fields;
+    const size_t rule_start
+        = symbol_start + field_size * symbol_fields * symbol_total;
+    const size_t end_start = rule_start + field_size * rule_fields * rule_total;
+    const size_t token_start = end_start + field_size * alternative_total;
+    const size_t name_start  = token_start + field_size * token_total;
+
+    if (name_start + name_total != data.size())
+        return invalid("the size does not match the header");
+
+    const auto * symbol_data = data.data() + symbol_start;
+    const auto * rule_data   = data.data() + rule_start;
+    const auto * end_data    = data.data() + end_start;
+    const auto * token_data  = data.data() + token_start;
+    const auto * name_data   = data.data() + name_start;
+
+    grammar to_ret{};
+
+    for (size_t index = 0; index < symbol_total; ++index) {
+        const auto * entry  = symbol_data + field_size * symbol_fields * index;
+        const auto   token  = get_token(entry);
+        const auto   offset = size_t{get(entry + field_size)};
+        const auto   length = size_t{get(entry + 2 * field_size)};
+
+        if (offset + length > name_total)
+            return invalid("a symbol name is out of bounds");
+
+        // The symbol table has a slot for every token up to the largest,
+        // so a corrupt token must not make it allocate without bound
+        const auto magnitude = static_cast<size_t>(
+            std::abs(static_cast<long long>(static_cast<int>(token))));
+        if (magnitude > data.size()) return invalid("a token is out of range");
+
+        const std::string_view name{name_data + offset, length};
+        if (token == rule_sep or to_ret.symbols.contains(token)
+            or to_ret.symbols.contains(name))
+            return invalid("a symbol or token is used twice");
+
+        to_ret.symbols.emplace(token, symbol_t{std::string{name}});
+    }
+
+    size_t alternative = 0;
+    size_t token_begin = 0;
+    for (size_t index = 0; index < rule_total; ++index) {
+        const auto * entry   = rule_data + field_size * rule_fields * index;
+        const auto   nonterm = get_token(entry);
+        const auto   count   = size_t{get(entry + field_size)};
+
+        if (nonterm <= rule_sep or not to_ret.symbols.contains(nonterm))
+            return invalid("a rule is not for a known nonterminal");
+        if (alternative + count > alternative_total)
+            return invalid("there are too few alternatives");
+
+        productions_t alternatives{};
+        for (const auto last = alternative + count; alternative < last;
+             ++alternative) {
+            const auto token_end = size_t{
+                get(end_data + field_size * alternative)};
+            if (token_end < token_begin or token_end > token_total)
+                return invalid("an alternative is out of bounds");
+
+            alternatives.start_alternative();
+            for (; token_begin < token_end; ++token_begin) {
+                const auto token
+                    = get_token(token_data + field_size * token_begin);
+                if (token == rule_sep or not to_ret.symbols.contains(token))
+                    return invalid("an alternative uses an unknown token");
+                alternatives.append(token);
+            }
+        }
+
+        if (not to_ret.rules.try_emplace(nonterm, std::move(alternatives))
+                    .second)
+            return invalid("a nonterminal has two rules");
+    }
+
+    if (alternative != alternative_total or token_begin != token_total)
+        return invalid("some alternatives or tokens are not in any rule");
+
+    diag.info("Successfully loaded binary grammar\n");
+    return to_ret;
+}
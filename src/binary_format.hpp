@@ -0,0 +1,43 @@
+#ifndef BINARY_FORMAT_HPP
+#define BINARY_FORMAT_HPP
+
+#include <cstdint>
+
+// The binary grammar format written by grammar::write_binary
+// and read by grammar::parse_binary.
+//
+// Every field is a 32-bit little-endian integer, so a file can be used on any
+// machine and read straight out of a mapped file without any tokenizing.
+// The file is laid out as:
+//   header         magic, version, and the counts below
+//   symbols        symbol_count  * { token, name offset, name length }
+//   rules          rule_count    * { nonterminal, alternative count }
+//   alternatives   alternative_count * { one past the alternative's last
+//                                        token, counted from the first token }
+//   tokens         token_count   * token
+//   names          name_bytes bytes of symbol names, back to back
+// The alternatives of each rule follow those of the rule before it.
+namespace binary_format {
+    // "CFGB"
+    inline constexpr std::uint32_t magic = 0x42474643u;
+
+    // Bumped whenever the layout changes.
+    // Files with any other version are rejected.
+    inline constexpr std::uint32_t version = 1;
+
+    enum header_field : std::uint32_t {
+        magic_field,
+        version_field,
+        symbol_count,
+        rule_count,
+        alternative_count,
+        token_count,
+        name_bytes,
+        header_fields,
+    };
+
+    inline constexpr std::uint32_t symbol_fields = 3;
+    inline constexpr std::uint32_t rule_fields   = 2;
+}  // namespace binary_format
+
+#endif
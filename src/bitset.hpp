@@ -0,0 +1,103 @@
+#ifndef BITSET_HPP
+#define BITSET_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A fixed size set of small integers, packed 64 to a word.
+// Unlike std::vector<bool>, whole sets can be merged a word at a time.
+class dynamic_bitset final {
+   public:
+    dynamic_bitset() = default;
+    explicit dynamic_bitset(size_t bit_count)
+        : bit_count{bit_count}
+        , words((bit_count + word_bits - 1) / word_bits, 0) {}
+
+    [[nodiscard]] size_t size() const { return bit_count; }
+
+    [[nodiscard]] bool test(size_t index) const {
+        return index < bit_count
+               and (words[index / word_bits] >> (index % word_bits)) & 1u;
+    }
+
+    void set(size_t index) {
+        words[index / word_bits] |= word_t{1} << (index % word_bits);
+    }
+
+    void reset(size_t index) {
+        words[index / word_bits] &= ~(word_t{1} << (index % word_bits));
+    }
+
+    // Resets every bit, keeping the size
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+
+    // Sets the bit and returns true if it was not already set
+    bool insert(size_t index) {
+        if (test(index)) return false;
+        set(index);
+        return true;
+    }
+
+    [[nodiscard]] bool any() const {
+        for (const auto word : words)
+            if (word != 0) return true;
+        return false;
+    }
+
+    [[nodiscard]] bool none() const { return not any(); }
+
+    [[nodiscard]] size_t count() const {
+        size_t to_ret = 0;
+        for (auto word : words)
+            for (; word != 0; word &= word - 1) ++to_ret;
+        return to_ret;
+    }
+
+    // Adds every member of `other`, which must be the same size, to this set.
+    // Returns true if this set changed.
+    bool merge(const dynamic_bitset & other) {
+        bool changed = false;
+        for (size_t index = 0; index < other.words.size(); ++index) {
+            const auto merged = words[index] | other.words[index];
+            changed |= merged != words[index];
+            words[index] = merged;
+        }
+        return changed;
+    }
+
+    // Calls func(index) for every member, in ascending order
+    template<typename func_t>
+    void for_each(func_t && func) const {
+        for (size_t index = 0; index < words.size(); ++index)
+            for (auto word = words[index]; word != 0; word &= word - 1)
+                func(index * word_bits + lowest_bit(word));
+    }
+
+    friend bool operator==(const dynamic_bitset & lhs,
+                           const dynamic_bitset & rhs) {
+        return lhs.bit_count == rhs.bit_count and lhs.words == rhs.words;
+    }
+
+   private:
+    using word_t = std::uint64_t;
+
+    static constexpr size_t word_bits = 64;
+
+    // The word must not be 0
+    [[nodiscard]] static size_t lowest_bit(word_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_ctzll(word));
+#else
+        size_t to_ret = 0;
+        for (; (word & 1u) == 0; word >>= 1u) ++to_ret;
+        return to_ret;
+#endif
+    }
+
+    size_t              bit_count = 0;
+    std::vector<word_t> words{};
+};
+
+#endif
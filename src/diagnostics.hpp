@@ -0,0 +1,63 @@
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include <iostream>
+
+// How much the library reports while it works
+enum class log_level {
+    // Only errors
+    quiet,
+    // Progress messages and results
+    normal,
+    // Everything, including per-symbol and per-rule details
+    verbose,
+};
+
+// Where the parser and the transforms send their messages.
+// A message above the configured level costs a single comparison:
+// its arguments are never formatted.
+// Nothing is flushed, so large amounts of output stay cheap.
+class diagnostics final {
+   public:
+    explicit diagnostics(log_level      level = log_level::normal,
+                         std::ostream & out   = std::cout,
+                         std::ostream & err   = std::cerr)
+        : level{level}
+        , out{out}
+        , err{err} {}
+
+    // The sink used when none is given: normal messages on stdout
+    static diagnostics & standard() {
+        static diagnostics instance{};
+        return instance;
+    }
+
+    [[nodiscard]] bool enabled(log_level message_level) const {
+        return message_level <= level;
+    }
+
+    [[nodiscard]] log_level current_level() const { return level; }
+
+    template<typename... args_t>
+    void info(const args_t &... args) {
+        if (enabled(log_level::normal)) (out << ... << args);
+    }
+
+    template<typename... args_t>
+    void verbose(const args_t &... args) {
+        if (enabled(log_level::verbose)) (out << ... << args);
+    }
+
+    // Errors are reported at every level
+    template<typename... args_t>
+    void error(const args_t &... args) {
+        (err << ... << args);
+    }
+
+   private:
+    log_level      level;
+    std::ostream & out;
+    std::ostream & err;
+};
+
+#endif
@@ -0,0 +1,528 @@
+#include "driver.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+
+#include "grammar_transform.hpp"
+#include "ll1.hpp"
+#include "mapped_file.hpp"
+#include "recognizer.hpp"
+#include "result_cache.hpp"
+#include "thread_pool.hpp"
+
+namespace fs = std::filesystem;
+
+std::optional<grammar> read_cfg(const std::string & filename, bool binary,
+                                diagnostics & diag) {
+    if (filename == "-" or filename == "--") {
+        if (not binary) return grammar::parse_from_stream(std::cin, diag);
+
+        const std::string data{std::istreambuf_iterator<char>{std::cin}, {}};
+        return grammar::parse_binary(data, diag);
+    }
+
+    if (const auto file = mapped_file::open(filename); file)
+        return binary ? grammar::parse_binary(file->view(), diag)
+                      : grammar::parse_from_file(file->view(), diag);
+
+    diag.error("Could not read ", filename, '\n');
+    return std::optional<grammar>{};
+}
+
+namespace {
+    // A missing or unreadable cache only means starting from scratch
+    left_recursion_cache load_cache(const std::string & filename,
+                                    diagnostics &       diag) {
+        const auto file = mapped_file::open(filename);
+        if (not file) {
+            diag.info("No results kept in ", filename, " yet\n");
+            return left_recursion_cache{};
+        }
+
+        if (auto cache = left_recursion_cache::load(file->view()); cache)
+            return std::move(*cache);
+
+        diag.error(filename,
+                   " does not hold kept results, so it is ignored\n");
+        return left_recursion_cache{};
+    }
+
+    // Every pass process_grammar runs, which is part of the cache key
+    std::string pass_list(const options & opts) {
+        std::string to_ret
+            = opts.by_components
+                  ? "make_proper_form remove_left_recursion_by_components"
+                  : "make_proper_form remove_left_recursion";
+        if (opts.left_factor) to_ret += " left_factor";
+        return to_ret;
+    }
+
+    // The time limit counts from now
+    resource_limits limits_of(const options & opts) {
+        resource_limits to_ret{};
+        to_ret.max_alternatives = opts.max_alternatives;
+        to_ret.max_tokens       = opts.max_tokens;
+        to_ret.max_memory_bytes = opts.max_memory;
+        if (opts.time_limit.count() != 0)
+            to_ret.deadline
+                = std::chrono::steady_clock::now() + opts.time_limit;
+        return to_ret;
+    }
+
+    // Conflicts past this many are only counted, unless asked for
+    constexpr size_t shown_conflicts = 20;
+
+    // Writes the terminal at an index of ll1_sets
+    void write_terminal(std::ostream & out, const grammar & cfg,
+                        const ll1_sets & sets, size_t terminal) {
+        if (terminal == sets.end_of_input())
+            out << "end of input";
+        else
+            out << cfg.symbol_of(ll1_sets::terminal_at(terminal));
+    }
+
+    void write_terminals(std::ostream & out, const grammar & cfg,
+                         const ll1_sets & sets, const dynamic_bitset & set) {
+        out << '{';
+        bool first = true;
+        set.for_each([&](size_t terminal) {
+            out << (first ? " " : ", ");
+            first = false;
+            write_terminal(out, cfg, sets, terminal);
+        });
+        out << " }";
+    }
+
+    void write_rule(std::ostream & out, const grammar & cfg,
+                    grammar::rule_t rule) {
+        out << '"';
+        for (size_t pos = 0; pos < rule.size(); ++pos)
+            out << (pos == 0 ? "" : " ") << cfg.symbol_of(rule[pos]);
+        out << '"';
+    }
+
+    // Builds the LL(1) table of the grammar and reports its conflicts.
+    // Returns false if there are any.
+    bool check_ll1(const grammar & cfg, diagnostics & diag,
+                   std::ostream & out) {
+        const ll1_sets  sets{cfg};
+        const ll1_table table{cfg, sets};
+
+        if (diag.enabled(log_level::verbose)) {
+            std::ostringstream text{};
+            for (const auto nonterm : cfg.nonterminals()) {
+                text << cfg.symbol_of(nonterm) << " nullable "
+                     << std::boolalpha << sets.nullable(nonterm)
+                     << ", FIRST ";
+                write_terminals(text, cfg, sets, sets.first(nonterm));
+                text << ", FOLLOW ";
+                write_terminals(text, cfg, sets, sets.follow(nonterm));
+                text << '\n';
+            }
+            diag.verbose(text.str());
+        }
+
+        const auto & conflicts = table.conflicts();
+        out << "LL(1) table: " << table.entry_count() << " entries, "
+            << conflicts.size() << " conflicts\n";
+
+        const auto shown = diag.enabled(log_level::verbose)
+                               ? conflicts.size()
+                               : std::min(conflicts.size(), shown_conflicts);
+        for (size_t index = 0; index < shown; ++index) {
+            const auto & conflict = conflicts[index];
+            const auto & rules    = cfg.alternatives(conflict.nonterminal);
+
+            out << "Conflict in " << cfg.symbol_of(conflict.nonterminal)
+                << " on ";
+            write_terminal(out, cfg, sets, conflict.terminal);
+            out << " between ";
+            write_rule(out, cfg, rules[conflict.kept]);
+            out << " and ";
+            write_rule(out, cfg, rules[conflict.other]);
+            out << '\n';
+        }
+        if (shown < conflicts.size())
+            out << "... and " << conflicts.size() - shown
+                << " more conflicts\n";
+
+        if (not table.is_ll1()) {
+            diag.error("The grammar is not LL(1)\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Runs the recognizer over each line of the corpus and reports how
+    // many lines were accepted and how fast.
+    // Returns false if the corpus could not be read.
+    bool recognize_corpus(const grammar & cfg, const std::string & filename,
+                          diagnostics & diag, std::ostream & out) {
+        const auto file = mapped_file::open(filename);
+        if (not file) {
+            diag.error("Could not read ", filename, '\n');
+            return false;
+        }
+
+        recognizer parser{cfg};
+
+        // Split up front, so only recognizing is timed
+        std::vector<std::vector<grammar::token_t>> strings{};
+        std::vector<size_t>                        line_numbers{};
+        size_t                                     unknown = 0;
+
+        auto data = file->view();
+        for (size_t line_number = 1; not data.empty(); ++line_number) {
+            const auto end  = data.find('\n');
+            auto       line = data.substr(0, end);
+            data            = end == std::string_view::npos
+                                  ? std::string_view{}
+                                  : data.substr(end + 1);
+            if (not line.empty() and line.back() == '\r')
+                line.remove_suffix(1);
+
+            if (auto tokens = parser.tokenize(line); tokens) {
+                strings.push_back(std::move(*tokens));
+                line_numbers.push_back(line_number);
+            } else {
+                diag.verbose("Line ", line_number,
+                             " has a symbol which is not a terminal\n");
+                ++unknown;
+            }
+        }
+
+        size_t     accepted = 0;
+        const auto start    = std::chrono::steady_clock::now();
+        for (size_t index = 0; index < strings.size(); ++index) {
+            if (parser.accepts(strings[index]))
+                ++accepted;
+            else
+                diag.verbose("Rejected line ", line_numbers[index], '\n');
+        }
+        const std::chrono::duration<double> elapsed
+            = std::chrono::steady_clock::now() - start;
+
+        out << "Recognized " << strings.size() << " strings with the "
+            << (parser.predictive() ? "predictive" : "memoized")
+            << " parser in " << elapsed.count() * 1000 << " ms ("
+            << (elapsed.count() > 0
+                    ? static_cast<double>(strings.size()) / elapsed.count()
+                    : 0.0)
+            << " strings/sec): " << accepted << " accepted, "
+            << strings.size() - accepted << " rejected\n";
+        if (unknown != 0)
+            out << unknown
+                << " lines had symbols which are not terminals and were "
+                   "skipped\n";
+        return true;
+    }
+
+    bool save_cache(const std::string &          filename,
+                    const left_recursion_cache & cache, diagnostics & diag) {
+        std::ofstream file{filename, std::ios::binary};
+        cache.save(file);
+        if (not file) {
+            diag.error("Could not write ", filename, '\n');
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
+bool process_grammar(const std::string & filename, const options & opts,
+                     pass_context & ctx, std::ostream & out) {
+    auto & diag = ctx.diag;
+    ctx.limits  = limits_of(opts);
+
+    auto cfg = grammar::empty();
+    if (auto input = read_cfg(filename, opts.binary_input, diag);
+        input and input->nonterminal_count() != 0)
+        cfg = std::move(input.value());
+    else {
+        diag.error("Error occurred in parsing\n");
+        return false;
+    }
+
+    diag.info(cfg, '\n');
+
+    if (diag.enabled(log_level::normal)) {
+        out << "Epsilon check\n";
+        const auto nonterms = cfg.nonterminals();
+        for (const auto & nonterm : nonterms) {
+            out << std::boolalpha << nonterm << " has epsilon? "
+                << cfg.is_nullable(nonterm) << '\n';
+        }
+
+        out << "\nCycle check\n";
+        const auto cycle_path = cfg.cyclic_path();
+        if (not cycle_path.empty()) {
+            out << "Found cycle\n";
+            bool print_arrow = false;
+            for (const auto & node : cycle_path) {
+                if (print_arrow) {
+                    out << " --> ";
+                } else {
+                    print_arrow = true;
+                }
+                out << node;
+            }
+            out << '\n';
+        } else {
+            out << "Could not find cycle\n";
+        }
+    }
+
+    std::optional<result_cache>         results{};
+    std::string                         key{};
+    std::optional<result_cache::result> found{};
+    if (not opts.cache_dir.empty()) {
+        results.emplace(opts.cache_dir);
+        key   = result_cache::key_of(cfg, pass_list(opts));
+        found = results->find(key);
+    }
+
+    std::optional<grammar> cleaned{};
+    if (found) {
+        // Stands for "Making cfg proper" and the messages of the passes,
+        // which did not run. The rest of the output is the same.
+        diag.info("Found the result in the cache\n");
+        diag.info(found->proper, '\n');
+        cleaned = std::move(found->cleaned);
+    } else {
+        // A pass which went over a limit has left nothing to use
+        try {
+            diag.info("Making cfg proper\n");
+            auto proper = make_proper_form(std::move(cfg), ctx);
+
+            diag.info(proper, '\n');
+
+            // Kept for the cache, as the next pass edits it
+            std::optional<grammar> stored_proper{};
+            if (results) stored_proper = proper;
+
+            if (opts.by_components) {
+                cleaned = remove_left_recursion_by_components(
+                    std::move(proper), ctx);
+            } else if (opts.incremental_file.empty()) {
+                cleaned = remove_left_recursion(std::move(proper), ctx);
+            } else {
+                auto cache = load_cache(opts.incremental_file, diag);
+                cleaned
+                    = remove_left_recursion(std::move(proper), cache, ctx);
+                if (cleaned
+                    and not save_cache(opts.incremental_file, cache, diag))
+                    return false;
+            }
+
+            if (not cleaned) {
+                diag.error("Could not clean the grammar\n");
+                return false;
+            }
+
+            if (opts.left_factor)
+                cleaned = left_factor(std::move(*cleaned), ctx);
+
+            // Another run can always redo the work, so this is not an error
+            if (results and not results->store(key, *stored_proper, *cleaned))
+                diag.info("Could not store the result in ", opts.cache_dir,
+                          '\n');
+        } catch (const resource_exhausted & error) {
+            diag.error(error.what(), '\n');
+            return false;
+        }
+    }
+
+    diag.info("Removed all left recursion from the grammar\n");
+    if (opts.text_output)
+        cleaned->write_text(out);
+    else
+        out << cleaned.value() << '\n';
+
+    if (not opts.binary_output.empty()) {
+        std::ofstream binary{opts.binary_output, std::ios::binary};
+        cleaned->write_binary(binary);
+        if (not binary) {
+            diag.error("Could not write ", opts.binary_output, '\n');
+            return false;
+        }
+    }
+
+    if (not opts.corpus.empty()
+        and not recognize_corpus(*cleaned, opts.corpus, diag, out))
+        return false;
+
+    if (opts.ll1 and not check_ll1(*cleaned, diag, out)) return false;
+
+    diag.info("END OF PROGRAM\n");
+    return true;
+}
+
+void trim_cache(const options & opts) {
+    if (not opts.cache_dir.empty())
+        result_cache{opts.cache_dir}.trim(opts.cache_size);
+}
+
+std::optional<std::vector<std::string>> collect_inputs(const options & opts,
+                                                       std::ostream &  err) {
+    std::vector<std::string> to_ret{};
+
+    for (const auto & filename : opts.filenames) {
+        std::error_code error{};
+        if (not fs::is_directory(filename, error)) {
+            to_ret.push_back(filename);
+            continue;
+        }
+
+        // Directory order is unspecified, so the files are sorted
+        std::vector<std::string> files{};
+        for (const auto & entry : fs::directory_iterator{filename, error})
+            if (entry.is_regular_file())
+                files.push_back(entry.path().string());
+
+        if (error) {
+            err << "Could not read the directory " << filename << ": "
+                << error.message() << '\n';
+            return std::optional<std::vector<std::string>>{};
+        }
+
+        std::sort(files.begin(), files.end());
+        to_ret.insert(to_ret.end(), files.begin(), files.end());
+    }
+
+    if (not opts.manifest.empty()) {
+        std::ifstream manifest_file{};
+        if (opts.manifest != "-") {
+            manifest_file.open(opts.manifest);
+            if (not manifest_file) {
+                err << "Could not read the manifest " << opts.manifest << '\n';
+                return std::optional<std::vector<std::string>>{};
+            }
+        }
+
+        auto & manifest = opts.manifest == "-" ? std::cin : manifest_file;
+        for (std::string line; std::getline(manifest, line);)
+            if (not line.empty()) to_ret.push_back(std::move(line));
+    }
+
+    return to_ret;
+}
+
+namespace {
+    // The result file for each input. Inputs sharing a name get the
+    // position of the later one added, so no result overwrites another.
+    std::vector<fs::path> output_paths(
+        const std::vector<std::string> & filenames, const fs::path & dir) {
+        std::vector<fs::path>           to_ret{};
+        std::unordered_set<std::string> used{};
+
+        for (size_t index = 0; index < filenames.size(); ++index) {
+            const auto & filename = filenames[index];
+            auto         name     = fs::path{filename}.filename().string();
+            if (filename == "-" or filename == "--") name = "stdin";
+
+            if (not used.insert(name).second) {
+                name += '.' + std::to_string(index);
+                used.insert(name);
+            }
+            to_ret.push_back(dir / (name + ".out"));
+        }
+
+        return to_ret;
+    }
+
+    struct batch_result {
+        std::string text;
+        bool        succeeded;
+    };
+}  // namespace
+
+size_t process_batch(const std::vector<std::string> & filenames,
+                     const options & opts, std::ostream & out) {
+    const bool to_files = not opts.output_dir.empty();
+    const auto paths    = to_files ? output_paths(filenames, opts.output_dir)
+                                   : std::vector<fs::path>{};
+
+    if (std::error_code error{};
+        to_files and not fs::create_directories(opts.output_dir, error)
+        and error) {
+        out << "Could not create " << opts.output_dir << ": "
+            << error.message() << '\n';
+        return filenames.size();
+    }
+
+    // Finished results wait here until every earlier one has been written,
+    // so the output is in input order however the work was scheduled
+    std::vector<std::optional<batch_result>> results(filenames.size());
+    std::mutex                               write_lock{};
+    size_t                                   next_to_write = 0;
+    size_t                                   failures      = 0;
+
+    const auto write_ready = [&] {
+        for (; next_to_write < results.size() and results[next_to_write];
+             ++next_to_write) {
+            const auto & filename = filenames[next_to_write];
+            auto &       result   = *results[next_to_write];
+
+            if (not result.succeeded) ++failures;
+
+            if (to_files)
+                out << filename << ": " << (result.succeeded ? "ok" : "failed")
+                    << '\n';
+            else
+                out << "==> " << filename
+                    << (result.succeeded ? "" : " (failed)") << " <==\n";
+            out << result.text;
+
+            // Only the status is needed from here on
+            results[next_to_write]->text = std::string{};
+        }
+    };
+
+    const auto process = [&](size_t index, size_t) {
+        // Messages and results go to the same buffer,
+        // so each grammar's output stays together
+        std::ostringstream buffer{};
+        diagnostics        diag{opts.verbosity, buffer, buffer};
+        pass_context       ctx{diag};
+
+        batch_result result{};
+        result.succeeded
+            = process_grammar(filenames[index], opts, ctx, buffer);
+
+        // With a file per grammar, only problems writing it go to `out`
+        if (to_files) {
+            std::ofstream file{paths[index]};
+            file << buffer.str();
+            if (not file) {
+                result.text
+                    = "Could not write " + paths[index].string() + '\n';
+                result.succeeded = false;
+            }
+        } else {
+            result.text = buffer.str();
+        }
+
+        std::lock_guard guard{write_lock};
+        results[index] = std::move(result);
+        write_ready();
+    };
+
+    if (opts.jobs == 1) {
+        for (size_t index = 0; index < filenames.size(); ++index)
+            process(index, 0);
+    } else {
+        thread_pool pool{opts.jobs};
+        pool.parallel_for(filenames.size(), process);
+    }
+
+    return failures;
+}
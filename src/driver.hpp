@@ -0,0 +1,42 @@
+#ifndef DRIVER_HPP
+#define DRIVER_HPP
+
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "grammar.hpp"
+#include "options.hpp"
+#include "pass_context.hpp"
+
+// What check_grammar does with each grammar it is given
+
+// Reads the grammar from the file, or from stdin for "-" and "--",
+// in the binary format if `binary` is set and as text otherwise
+[[nodiscard]] std::optional<grammar> read_cfg(const std::string & filename,
+                                              bool binary, diagnostics & diag);
+
+// Reads, checks, and transforms one grammar,
+// writing the results to `out` and messages to `ctx.diag`.
+// Returns false if any step failed.
+bool process_grammar(const std::string & filename, const options & opts,
+                     pass_context & ctx, std::ostream & out);
+
+// Keeps the shared result cache, if there is one, within its size
+void trim_cache(const options & opts);
+
+// The grammars named on the command line, with each directory replaced by
+// the files in it and the manifest's entries added at the end.
+// Returns nothing if a directory or the manifest could not be read.
+[[nodiscard]] std::optional<std::vector<std::string>> collect_inputs(
+    const options & opts, std::ostream & err);
+
+// Processes every grammar on a pool of opts.jobs workers.
+// The results are written in input order, either each to its own file in
+// opts.output_dir or one after another to `out`, each under a header.
+// Returns the number of grammars which failed.
+size_t process_batch(const std::vector<std::string> & filenames,
+                     const options & opts, std::ostream & out);
+
+#endif
@@ -3,84 +3,133 @@
 #include <algorithm>
 #include <cctype>
 #include <iomanip>
-#include <iostream>
-#include <numeric>
-#include <set>
-
-using token_t  = grammar::token_t;
-using symbol_t = grammar::symbol_t;
-using rule_t   = std::vector<token_t>;
-
-std::optional<grammar> grammar::parse_from_file(const std::string & data) {
-    grammar     to_ret{};
-    auto        iter = data.begin();
-    token_t     nonterm{0};
-    std::string nonterm_symbol;
-    size_t      line_num = 1;
-
-    const auto consume_whitespace = [&iter, &data] {
-        while (iter != data.end() and isspace(*iter)) iter++;
+
+using token_t       = grammar::token_t;
+using symbol_t      = grammar::symbol_t;
+using productions_t = grammar::productions_t;
+
+namespace {
+    // Nonterminals must either be capitalized or surrounded with <>
+    bool is_nonterminal_name(std::string_view symbol) {
+        return not symbol.empty()
+               and (isupper(static_cast<unsigned char>(symbol.front()))
+                    or symbol.front() == '<');
+    }
+}  // namespace
+
+std::optional<grammar> grammar::parse_from_file(std::string_view data,
+                                                diagnostics &    diag) {
+    grammar to_ret{};
+    size_t  line_num = 1;
+
+    if (not to_ret.parse_statements(data, line_num, diag))
+        return std::optional<grammar>{};
+
+    diag.info("Successfully parsed grammar\n");
+    return to_ret;
+}
+
+std::optional<grammar> grammar::parse_from_stream(std::istream & input,
+                                                  diagnostics &  diag,
+                                                  size_t         chunk_size) {
+    grammar to_ret{};
+    size_t  line_num = 1;
+
+    // Holds the statement that is cut off at the end of the last chunk
+    std::string pending{};
+    std::string chunk(chunk_size, '\0');
+
+    while (input.read(chunk.data(), chunk.size()) or input.gcount() > 0) {
+        pending.append(chunk.data(), input.gcount());
+
+        // Symbols cannot contain ';', so every statement up to the last ';'
+        // is complete
+        if (const auto last_end = pending.rfind(';');
+            last_end != std::string::npos) {
+            if (not to_ret.parse_statements(
+                    std::string_view{pending}.substr(0, last_end + 1),
+                    line_num, diag))
+                return std::optional<grammar>{};
+            pending.erase(0, last_end + 1);
+        }
+    }
+
+    if (not to_ret.parse_statements(pending, line_num, diag))
+        return std::optional<grammar>{};
+
+    diag.info("Successfully parsed grammar\n");
+    return to_ret;
+}
+
+bool grammar::parse_statements(std::string_view data, size_t & line_num,
+                               diagnostics & diag) {
+    size_t pos = 0;
+
+    const auto at_end = [&pos, &data] { return pos >= data.size(); };
+
+    const auto consume_whitespace = [&pos, &data, &at_end] {
+        while (not at_end() and isspace(static_cast<unsigned char>(data[pos])))
+            pos++;
     };
 
-    const auto error = [&line_num]() -> std::ostream & {
-        return std::cerr << "Line " << std::setw(2) << line_num << " : ";
+    const auto error = [&line_num, &diag](const auto &... message) {
+        diag.error("Line ", std::setw(2), line_num, " : ", message...);
     };
 
+    // The returned view points into `data`
     const auto consume_symbol
-        = [&iter, &data, &consume_whitespace]() -> std::optional<std::string> {
-        if (std::string symbol; iter != data.end()) {
-            consume_whitespace();
-
-            if (*iter == '<') {
-                // time to eat a whole symbol
-                do {
-                    symbol += *iter;
-                    ++iter;
-
-                    if (*iter == '<' or *iter == ';'
-                        or *iter == grammar::rule_sep or *iter == '\n') {
-                        std::cerr << "Cannot use ';', '<', '|', or newline in "
-                                     "a symbol "
-                                     "name\nOffending name:"
-                                  << symbol << std::endl;
-                        return std::optional<std::string>{};
-                    }
-                } while (*iter != '>');
-
-                // Append the '>'
-                iter++;
-                symbol += '>';
-                return std::optional{symbol};
-            } else {
-                auto sym = *iter;
-                iter++;
-                return std::optional{std::string(1, sym)};
-            }
+        = [&pos, &data, &at_end, &consume_whitespace,
+           &diag]() -> std::optional<std::string_view> {
+        consume_whitespace();
+        if (at_end()) {
+            diag.error("Unexpected end of file\n");
+            return std::optional<std::string_view>{};
         }
 
-        std::cerr << "Unexpected end of file" << std::endl;
-        return std::optional<std::string>{};
+        const auto start = pos;
+        if (data[pos] == '<') {
+            // time to eat a whole symbol
+            do {
+                ++pos;
+
+                if (at_end() or data[pos] == '<' or data[pos] == ';'
+                    or data[pos] == '|' or data[pos] == '\n') {
+                    diag.error(
+                        "Cannot use ';', '<', '|', or newline in a symbol "
+                        "name\nOffending name:",
+                        data.substr(start, pos - start), '\n');
+                    return std::optional<std::string_view>{};
+                }
+            } while (data[pos] != '>');
+
+            // Include the '>'
+            pos++;
+            return data.substr(start, pos - start);
+        } else {
+            pos++;
+            return data.substr(start, 1);
+        }
     };
 
-    while (iter < data.end()) {
+    while (not at_end()) {
         // Remove initial whitespace
         consume_whitespace();
-        if (iter >= data.end()) break;
+        if (at_end()) break;
 
         // Read initial symbol
+        token_t          nonterm{0};
+        std::string_view nonterm_symbol;
         if (auto symbol = consume_symbol();
-            symbol
-            and (isupper(symbol.value().front())
-                 or symbol.value().front() == '<')) {
+            symbol and is_nonterminal_name(symbol.value())) {
             nonterm_symbol = symbol.value();
-            nonterm        = to_ret.get_nonterminal(symbol_t{nonterm_symbol});
-            std::cout << "Using token " << nonterm << " for nonterminal "
-                      << nonterm_symbol << std::endl;
+            nonterm        = intern_nonterminal(nonterm_symbol);
+            diag.verbose("Using token ", nonterm, " for nonterminal ",
+                         nonterm_symbol, '\n');
         } else {
-            error() << "Cannot use " << *iter
-                    << " as a nonterminal\nNonterminals must either be "
-                       "capitalized or surrounded with <>\n";
-            return std::optional<grammar>{};
+            error("Cannot use ", symbol.value_or("the end of the file"),
+                  " as a nonterminal\nNonterminals must either be "
+                  "capitalized or surrounded with <>\n");
+            return false;
         }
 
         // remove whitespace between symbol and hyphen
@@ -88,96 +137,86 @@ std::optional<grammar> grammar::parse_from_file(const std::string & data) {
 
         // consume all hyphens
         bool ate_hyphen = false;
-        while (iter != data.end() and *iter == '-') {
-            iter++;
+        while (not at_end() and data[pos] == '-') {
+            pos++;
             ate_hyphen = true;
         }
         if (not ate_hyphen) {
-            error() << "Expected some hyphens after nonterminal "
-                    << nonterm_symbol << std::endl;
+            error("Expected some hyphens after nonterminal ", nonterm_symbol,
+                  '\n');
         }
 
         // remove whitespace
         consume_whitespace();
 
-        rule_t rule_list{};
+        productions_t rule_list{};
+        rule_list.start_alternative();
 
         // Go to the end of the line
         // consuming the rest of the line as the rule
-        while (iter < data.end() and *iter != ';') {
+        while (not at_end() and data[pos] != ';') {
             if (auto sym = consume_symbol(); sym) {
-                if (auto symbol = sym.value(); symbol == rule_sep_char())
-                    rule_list.push_back(rule_sep);
-                else if (symbol_t temp_sym{symbol};
-                         isupper(symbol.front()) or symbol.front() == '<')
-                    rule_list.push_back(to_ret.get_nonterminal(temp_sym));
+                if (auto symbol = sym.value();
+                    symbol == static_cast<const std::string &>(rule_sep_char()))
+                    rule_list.start_alternative();
+                else if (is_nonterminal_name(symbol))
+                    rule_list.append(intern_nonterminal(symbol));
                 else
-                    rule_list.push_back(to_ret.get_terminal(temp_sym));
+                    rule_list.append(intern_terminal(symbol));
             } else {
-                error() << "Could not consume next symbol in production for "
-                        << nonterm << std::endl
-                        << "Successfully parsed the following:"
-                        << std::string{data.begin(), iter} << std::endl;
-                return std::optional<grammar>{};
+                error("Could not consume next symbol in production for ",
+                      nonterm, "\nSuccessfully parsed the following:",
+                      data.substr(0, pos), '\n');
+                return false;
             }
             consume_whitespace();
         }
 
-        to_ret.rules.emplace(nonterm, std::move(rule_list));
-        iter++;
+        rules.emplace(nonterm, std::move(rule_list));
+        pos++;
         line_num++;
     }
 
-    std::cout << "Successfully parsed grammar\n";
-    return to_ret;
+    invalidate_analyses();
+    return true;
 }
 
-std::vector<std::vector<token_t>> grammar::rule_matrix(
-    token_t nonterminal) const {
-    std::vector<std::vector<token_t>> to_ret{{}};
-
-    if (rules.count(nonterminal) != 0) {
-        const auto & all_rules = rules.at(nonterminal);
+const productions_t & grammar::alternatives(token_t nonterminal) const {
+    static const productions_t no_alternatives{};
 
-        to_ret.reserve(
-            std::count(all_rules.begin(), all_rules.end(), rule_sep));
+    if (const auto iter = rules.find(nonterminal); iter != rules.end())
+        return iter->second;
+    else
+        return no_alternatives;
+}
 
-        for (const auto & symbol : all_rules) {
-            if (symbol == rule_sep) {
-                to_ret.emplace_back();
-            } else {
-                to_ret.back().push_back(symbol);
-            }
-        }
-    }
+token_t grammar::get_nonterminal(const symbol_t & symbol) {
+    return intern_nonterminal(static_cast<const std::string &>(symbol));
+}
 
-    return to_ret;
+token_t grammar::get_terminal(const symbol_t & symbol) {
+    return intern_terminal(static_cast<const std::string &>(symbol));
 }
 
-token_t grammar::get_nonterminal(const symbol_t & symbol) {
-    const auto iter = std::find_if(
-        symbols.begin(), symbols.end(),
-        [&symbol](const auto & item) { return item.second == symbol; });
-    if (iter != symbols.end()) {
-        return iter->first;
+token_t grammar::intern_nonterminal(std::string_view symbol) {
+    if (const auto existing = symbols.find(symbol); existing) {
+        return existing.value();
     } else {
         const auto to_ret = next_nonterminal();
-        symbols[to_ret]   = symbol;
+        symbols.emplace(to_ret, symbol_t{std::string{symbol}});
+        invalidate_analyses();
         // Rules are added in the parser / manually
         return to_ret;
     }
 }
 
-token_t grammar::get_terminal(const symbol_t & symbol) {
-    const auto iter = std::find_if(
-        symbols.begin(), symbols.end(),
-        [&symbol](const auto & item) { return item.second == symbol; });
-
-    if (iter != symbols.end()) {
-        return iter->first;
+token_t grammar::intern_terminal(std::string_view symbol) {
+    if (const auto existing = symbols.find(symbol); existing) {
+        return existing.value();
     } else {
         const auto to_ret = next_terminal();
-        symbols[to_ret]   = symbol;
+        symbols.emplace(to_ret, symbol_t{std::string{symbol}});
+        invalidate_analyses();
         return to_ret;
     }
 }
@@ -186,106 +225,156 @@ bool grammar::has_empty_production(token_t nonterminal) const {
     if (nonterminal <= 0) return false;
 
     const auto & rule_list = rules.at(nonterminal);
+    return std::any_of(rule_list.begin(), rule_list.end(),
+                       [](const auto & rule) { return rule.empty(); });
+}
+
+size_t grammar::token_space() const {
+    return static_cast<size_t>(static_cast<int>(symbols.max_token())) + 1;
+}
+
+dynamic_bitset grammar::derivation_fixpoint(bool terminals_allowed) const {
+    const auto     token_count = token_space();
+    dynamic_bitset to_ret{token_count};
+
+    // For every alternative still waiting on some nonterminals:
+    // its nonterminal, and how many of its nonterminals are not yet marked
+    std::vector<std::pair<token_t, size_t>> pending{};
+    // For every nonterminal: the pending alternatives it appears in,
+    // once for each appearance
+    std::vector<std::vector<size_t>> appears_in(token_count);
+    std::vector<token_t>             worklist{};
+
+    const auto mark = [&to_ret, &worklist](token_t nonterm) {
+        if (to_ret.insert(static_cast<int>(nonterm)))
+            worklist.push_back(nonterm);
+    };
+
+    for (const auto & [nonterm, options] : rules)
+        for (const auto rule : options) {
+            const auto terminal_count = std::count_if(
+                rule.begin(), rule.end(), [](auto token) { return token < 0; });
+            if (terminal_count != 0 and not terminals_allowed) continue;
+
+            const auto nonterminal_count = rule.size() - terminal_count;
+            if (nonterminal_count == 0) {
+                mark(nonterm);
+                continue;
+            }
+
+            for (const auto token : rule)
+                if (token > 0)
+                    appears_in[static_cast<int>(token)].push_back(
+                        pending.size());
+            pending.emplace_back(nonterm, nonterminal_count);
+        }
+
+    // Each appearance is decremented at most once,
+    // so this is linear in the size of the grammar
+    while (not worklist.empty()) {
+        const auto nonterm = worklist.back();
+        worklist.pop_back();
 
-    // An initial separator = empty production
-    bool last_was_sep = true;
-    for (const auto & sym : rule_list) {
-        if (sym == rule_sep and last_was_sep)
-            return true;  // Pipes surrounding nothing = empty production
-        else
-            last_was_sep = sym == rule_sep;
+        for (const auto alternative : appears_in[static_cast<int>(nonterm)])
+            if (auto & [head, remaining] = pending[alternative];
+                --remaining == 0)
+                mark(head);
     }
 
-    // Separator at the end = empty production
-    return last_was_sep;
+    return to_ret;
 }
 
-std::vector<token_t> grammar::cyclic_path() const {
-    // Path so far
-    std::vector<std::pair<token_t /*token*/, size_t /*option*/>> path{};
+const dynamic_bitset & grammar::nullable() const {
+    if (not nullable_cache) nullable_cache.emplace(derivation_fixpoint(false));
+    return nullable_cache.value();
+}
 
-    size_t start_symbol = 1;
+const dynamic_bitset & grammar::productive() const {
+    if (not productive_cache)
+        productive_cache.emplace(derivation_fixpoint(true));
+    return productive_cache.value();
+}
 
-    while (start_symbol < nonterminal_count()) {
-        // Pick start point
-        if (path.empty()) {
-            path.emplace_back(start_symbol, -1);
-            start_symbol++;
+std::vector<token_t> grammar::reachable_from(token_t start,
+                                             bool    only_productive) const {
+    const auto * usable = only_productive ? &productive() : nullptr;
+
+    dynamic_bitset       seen{token_space()};
+    std::vector<token_t> to_ret{start};
+    seen.set(static_cast<int>(start));
+
+    // The list of reachable nonterminals doubles as the worklist
+    for (size_t next = 0; next < to_ret.size(); ++next)
+        for (const auto rule : alternatives(to_ret[next])) {
+            if (usable != nullptr
+                and std::any_of(rule.begin(), rule.end(), [usable](auto token) {
+                        return token > 0
+                               and not usable->test(static_cast<int>(token));
+                    }))
+                continue;
+
+            for (const auto token : rule)
+                if (token > 0 and seen.insert(static_cast<int>(token)))
+                    to_ret.push_back(token);
         }
 
-        // Read the options of the path and which option to chose
-        const auto & current_symbol = path.back().first;
-        const auto & options        = rules.at(current_symbol);
-        auto         rule_used      = path.back().second + 1;
-
-        const auto old_path_length = path.size();
-        while (path.size() == old_path_length) {
-            if (rule_used < options.size()
-                and options.at(rule_used) > 0
-                // the rule used is pointing at a nonterminal
-                and options.at(rule_used) != current_symbol
-                // the rule is not generating the same symbol
-                and (rule_used == 0 /*there is nothing to the left of us*/
-                     or options.at(rule_used - 1) == rule_sep
-                     /*the left is a rule separator*/)
-                and (rule_used == options.size() - 1
-                     or options.at(rule_used + 1) == rule_sep)) {
-                // found a valid rule to use
-                path.back().second = rule_used;
-                path.emplace_back(options.at(rule_used), -1);
-            } else {
-                // move to the next valid rule
-                while (rule_used < options.size()
-                       and options.at(rule_used) != rule_sep)
-                    rule_used++;
-                rule_used++;
-                if (rule_used >= options.size()) {
-                    // used all options -> go back
-                    path.pop_back();
-                }
-            }
-        }
+    return to_ret;
+}
 
-        // Check the path for repeats
-        std::set<token_t> seen_nonterminals{};
-        for (const auto & entry : path)
-            if (seen_nonterminals.count(entry.first) != 0) {
-                std::vector<token_t> to_ret;
-                to_ret.reserve(path.size());
-                std::transform(path.begin(), path.end(),
-                               std::back_inserter(to_ret),
-                               [](const auto & entry) { return entry.first; });
-                return to_ret;
-            } else
-                seen_nonterminals.insert(entry.first);
-    }
+const grammar::unit_graph & grammar::unit_productions() const {
+    if (unit_cache) return unit_cache.value();
+
+    std::vector<std::pair<digraph::vertex_t, digraph::vertex_t>> edges;
+    for (const auto & [nonterm, options] : rules)
+        for (const auto rule : options)
+            // A rule that is a single nonterminal,
+            // which is not generating the same symbol
+            if (rule.size() == 1 and rule.front() > 0
+                and rule.front() != nonterm)
+                edges.emplace_back(static_cast<int>(nonterm),
+                                   static_cast<int>(rule.front()));
+
+    digraph graph{token_space(), edges};
+    auto components = find_strong_components(graph);
+    unit_cache.emplace(unit_graph{std::move(graph), std::move(components)});
+    return unit_cache.value();
+}
+
+std::vector<token_t> grammar::cyclic_path() const {
+    const auto & [graph, components] = unit_productions();
+    if (not components.any_cyclic()) return {};
+
+    // Report the cycle through the smallest nonterminal on any cycle,
+    // so the answer does not depend on the order of the components
+    for (digraph::vertex_t vertex = 1; vertex < graph.vertex_count(); ++vertex)
+        if (components.cyclic[components.component_of[vertex]]) {
+            const auto path = find_cycle_through(graph, components, vertex);
+
+            std::vector<token_t> to_ret;
+            to_ret.reserve(path.size());
+            std::transform(path.begin(), path.end(), std::back_inserter(to_ret),
+                           [](auto vertex) {
+                               return token_t{static_cast<int>(vertex)};
+                           });
+            return to_ret;
+        }
 
     return {};
 }
+
 bool grammar::using_symbol(const symbol_t & symbol) const {
-    return std::find_if(
-               symbols.begin(), symbols.end(),
-               [&symbol](const auto & entry) { return entry.second == symbol; })
-           != symbols.end();
+    return symbols.contains(symbol);
 }
 bool grammar::is_nonterminal_symbol(symbol_t symbol) const {
-    if (auto iter = std::find_if(
-            symbols.begin(), symbols.end(),
-            [&symbol](auto & entry) { return entry.second == symbol; });
-        iter != symbols.end())
-        return this->rules.count(iter->first) == 1
-               and this->using_symbol(symbol);
+    if (const auto token = symbols.find(symbol); token)
+        return this->rules.count(token.value()) == 1;
     else
         return false;
 }
 
 [[maybe_unused]] bool grammar::is_terminal_symbol(symbol_t symbol) const {
-    if (auto iter = std::find_if(
-            symbols.begin(), symbols.end(),
-            [&symbol](auto & entry) { return entry.second == symbol; });
-        iter != symbols.end())
-        return this->rules.count(iter->first) == 0
-               and this->using_symbol(symbol);
+    if (const auto token = symbols.find(symbol); token)
+        return this->rules.count(token.value()) == 0;
     else
         return false;
 }
@@ -294,91 +383,138 @@ std::ostream & operator<<(std::ostream & lhs, const grammar & rhs) {
     static constexpr auto arrow  = " --> ";
     static const auto     column = std::setw(2);
 
-    lhs << "Symbol mapping (Negative = terminal):" << std::endl;
-    for (const auto & entry : rhs.symbols) {
-        lhs << column << entry.first << arrow << column << entry.second << '\n';
-    }
+    lhs << "Symbol mapping (Negative = terminal):\n";
+    rhs.symbols.for_each([&lhs](auto token, const auto & symbol) {
+        lhs << column << token << arrow << column << symbol << '\n';
+    });
 
-    lhs << "Rules:" << std::endl;
+    lhs << "Rules:\n";
     for (const auto & entry : rhs.rules) {
         lhs << column << entry.first << arrow;
-        for (const auto & symbol : entry.second) {
-            if (symbol == grammar::rule_sep)
-                lhs << ' ' << grammar::rule_sep_char() << ' ';
+        bool first = true;
+        for (const auto rule : entry.second) {
+            if (first)
+                first = false;
             else
-                lhs << column << symbol << ' ';
+                lhs << ' ' << grammar::rule_sep_char() << ' ';
+
+            for (const auto & symbol : rule) lhs << column << symbol << ' ';
         }
-        lhs << std::endl;
+        lhs << '\n';
     }
 
-    lhs << "Rules Prettified:" << std::endl;
+    lhs << "Rules Prettified:\n";
     for (const auto & entry : rhs.rules) {
         lhs << column << rhs.symbols.at(entry.first) << arrow;
-        for (const auto & tok : entry.second) {
-            if (tok == grammar::rule_sep)
-                lhs << ' ' << grammar::rule_sep_char() << ' ';
+        bool first = true;
+        for (const auto rule : entry.second) {
+            if (first)
+                first = false;
             else
+                lhs << ' ' << grammar::rule_sep_char() << ' ';
+
+            for (const auto & tok : rule)
                 lhs << column << rhs.symbols.at(tok) << ' ';
         }
-        lhs << std::endl;
+        lhs << '\n';
     }
 
-    return lhs << std::endl;
+    return lhs << '\n';
 }
 
-token_t grammar::next_nonterminal() const {
-    return std::max_element(
-               symbols.begin(), symbols.end(),
-               [](auto & lhs, auto & rhs) { return lhs.first < rhs.first; })
-               ->first
-           + 1;
-}
+void grammar::write_text(std::ostream & out) const {
+    static constexpr size_t block_size = size_t{1} << 16u;
+
+    std::string buffer{};
+    buffer.reserve(block_size);
+
+    const auto flush = [&out, &buffer] {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    const auto append = [this, &buffer](token_t token) {
+        buffer += static_cast<const std::string &>(symbols.at(token));
+    };
+
+    // The initial symbol is the first nonterminal read back, so it is
+    // written even if it derives nothing. "X - X ;" derives nothing too.
+    if (const std::vector nonterms = nonterminals();
+        not nonterms.empty() and alternatives(nonterms.front()).empty()) {
+        append(nonterms.front());
+        buffer += " - ";
+        append(nonterms.front());
+        buffer += " ;\n";
+    }
+
+    for (const auto & [nonterm, alternatives] : rules) {
+        // "X - ;" would be read back as one empty alternative
+        if (alternatives.empty()) continue;
 
-token_t grammar::next_terminal() const {
-    return std::min_element(
-               symbols.begin(), symbols.end(),
-               [](auto & lhs, auto & rhs) { return lhs.first < rhs.first; })
-               ->first
-           - 1;
+        append(nonterm);
+        buffer += " -";
+
+        bool first = true;
+        for (const auto rule : alternatives) {
+            if (not first) buffer += " |";
+            first = false;
+
+            for (const auto token : rule) {
+                buffer += ' ';
+                append(token);
+            }
+        }
+        buffer += " ;\n";
+
+        if (buffer.size() >= block_size) flush();
+    }
+
+    flush();
 }
 
-symbol_t grammar::next_nonterminal_symbol() const {
-    const auto symbol_list = this->symbol_list();
+token_t grammar::next_nonterminal() const { return symbols.max_token() + 1; }
+
+token_t grammar::next_terminal() const { return symbols.min_token() - 1; }
 
-    return std::accumulate(
-        symbol_list.cbegin(), symbol_list.cend(), symbol_t{},
-        [](const auto & to_ret, const auto & sym) -> symbol_t {
-            auto symbol = static_cast<std::string>(sym);
-            if (isupper(symbol.front()) and to_ret <= sym) {
-                symbol[0] += 1;
-                return symbol_t{symbol};
-            } else
-                return to_ret;
-        });
+symbol_t grammar::fresh_nonterminal_symbol(token_t origin) {
+    std::string_view name{static_cast<const std::string &>(symbols.at(origin))};
+    if (name.size() > 2 and name.front() == '<' and name.back() == '>')
+        name = name.substr(1, name.size() - 2);
+
+    // The user may have already used a name like <A_1>, so skip over those
+    auto &      suffix = fresh_suffixes[std::string{name}];
+    std::string to_ret;
+    do {
+        to_ret = '<';
+        to_ret.append(name).append("_").append(std::to_string(++suffix));
+        to_ret += '>';
+    } while (symbols.contains(std::string_view{to_ret}));
+
+    return symbol_t{std::move(to_ret)};
 }
 
 std::vector<token_t> grammar::nonterminals() const {
     std::vector<token_t> to_ret{};
-    for (const auto & entry : symbols) {
-        if (entry.first > 0) { to_ret.push_back(entry.first); }
-    }
+    symbols.for_each([&to_ret](auto token, const auto &) {
+        if (token > 0) { to_ret.push_back(token); }
+    });
     return to_ret;
 }
 
 std::vector<token_t> grammar::terminals() const {
     std::vector<token_t> to_ret{};
-    for (const auto & entry : symbols) {
-        if (entry.first < 0) { to_ret.push_back(entry.first); }
-    }
+    symbols.for_each([&to_ret](auto token, const auto &) {
+        if (token < 0) { to_ret.push_back(token); }
+    });
     return to_ret;
 }
 
 std::vector<symbol_t> grammar::symbol_list() const {
     std::vector<symbol_t> to_ret;
     to_ret.reserve(symbols.size());
-    for (const auto & [_, letter] : symbols) {
-        if (letter != rule_sep_char()) to_ret.emplace_back(letter);
-    }
+    symbols.for_each([&to_ret](auto token, const auto & letter) {
+        if (token != rule_sep) to_ret.emplace_back(letter);
+    });
     return to_ret;
 }
 
@@ -399,20 +535,17 @@ std::map<token_t, symbol_t> grammar::terminal_keys() const {
     return to_ret;
 }
 
-bool grammar::add_rule(const symbol_t & symbol, std::vector<token_t> && rule) {
+bool grammar::add_rule(const symbol_t & symbol, productions_t && rule) {
+    invalidate_analyses();
     if (this->is_nonterminal_symbol(symbol)) {
         const auto nonterm = get_nonterminal(symbol);
-        if (auto [iter, inserted] = rules.emplace(nonterm, std::move(rule));
-            not inserted) {
-            auto & existing_rule = iter->second;
-            existing_rule.emplace_back(rule_sep);
-            for (const auto & token : existing_rule)
-                existing_rule.emplace_back(token);
-        }
+        if (auto [iter, inserted]
+            = rules.try_emplace(nonterm, std::move(rule));
+            not inserted)
+            iter->second.append_alternatives(rule);
 
         return true;
-    } else if (auto first_char = static_cast<std::string>(symbol).front();
-               isupper(first_char) or first_char == '<') {
+    } else if (is_nonterminal_name(static_cast<const std::string &>(symbol))) {
         auto nonterm = this->get_nonterminal(symbol);
         rules.emplace(nonterm, std::move(rule));
         return true;
@@ -421,37 +554,56 @@ bool grammar::add_rule(const symbol_t & symbol, std::vector<token_t> && rule) {
 }
 
 token_t grammar::add_terminal(const symbol_t & symbol, token_t term) {
-    if (symbols.count(term) == 0) {
+    if (const auto existing = symbols.find(symbol); existing)
+        return existing.value();
+
+    if (not symbols.contains(term)) {
         symbols.emplace(term, symbol);
+        invalidate_analyses();
         return term;
-    } else if (symbols.at(term) == symbol)
-        return term;
-
-    for (auto & entry : symbols)
-        if (entry.second == symbol) return entry.first;
+    }
 
     return this->get_terminal(symbol);
 }
 
 token_t grammar::add_nonterminal(const symbol_t & symbol, token_t nonterm) {
-    if (symbols.count(nonterm) == 0) {
+    if (const auto existing = symbols.find(symbol); existing)
+        return existing.value();
+
+    if (not symbols.contains(nonterm)) {
         symbols.emplace(nonterm, symbol);
+        invalidate_analyses();
         return nonterm;
-    } else if (symbols.at(nonterm) == symbol)
-        return nonterm;
-
-    for (auto & entry : symbols)
-        if (entry.second == symbol) return entry.first;
+    }
 
     return this->get_nonterminal(symbol);
 }
-grammar grammar::copy_terminals_from(const grammar & input) {
+void grammar::replace_alternatives(token_t nonterminal, productions_t && rule) {
+    invalidate_analyses();
+    rules[nonterminal] = std::move(rule);
+}
+
+void grammar::erase_nonterminal(token_t nonterminal) {
+    invalidate_analyses();
+    rules.erase(nonterminal);
+    symbols.erase(nonterminal);
+}
+
+token_t grammar::new_nonterminal(const symbol_t & symbol) {
+    invalidate_analyses();
+    const auto to_ret = next_nonterminal();
+    symbols.emplace(to_ret, symbol);
+    return to_ret;
+}
+
+grammar grammar::copy_terminals_from(const grammar & input,
+                                     diagnostics &   diag) {
     auto output = grammar{};
 
     // Copy over the terminals
     for (const auto & term : input.terminal_keys())
         if (output.add_terminal(term.second, term.first) != term.first)
-            std::cout << term.second << " was remapped!\n";
+            diag.verbose(term.second, " was remapped!\n");
 
     return output;
 }
@@ -3,20 +3,26 @@
 
 #include <algorithm>
 #include <ios>
+#include <iosfwd>
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "bitset.hpp"
+#include "diagnostics.hpp"
+#include "graph.hpp"
+#include "production_list.hpp"
 #include "strong_types.hpp"
+#include "symbol_table.hpp"
 
 // This class stores the grammar, while allowing some higher level manipulations
 // on it. The nonterminals are the positive numbers, while the terminals are the
 // negative numbers.
 class grammar {
-    // TODO: Write replace_rule
     // TODO: Sort the member functions both in the header and cpp
-    // TODO: Convert to the rule_t = std::vector<token_t>
 
     struct token_tag {};
     struct symbol_tag {};
@@ -32,20 +38,48 @@ class grammar {
     // It is exposed as part of the interface for strong typing support.
     using symbol_t = strong_t<std::string, symbol_tag>;
 
+    // All of the alternatives of a nonterminal, stored contiguously.
+    using productions_t = production_list<token_t>;
+
+    // A non-owning view of one alternative
+    using rule_t = productions_t::rule_t;
+
     static constexpr token_t             rule_sep{0};
     [[nodiscard]] static inline symbol_t rule_sep_char() {
         return symbol_t{"|"};
     };
 
     static grammar                              empty() { return grammar{}; }
+    // Parses a grammar held entirely in memory, such as a mapped file.
+    // Symbols are looked up straight from the data, without copying them.
     [[nodiscard]] static std::optional<grammar> parse_from_file(
-        const std::string & data);
+        std::string_view data, diagnostics & diag = diagnostics::standard());
+    // Parses a grammar read from the stream `chunk_size` bytes at a time.
+    // Only one chunk and one partial statement are kept in memory.
+    [[nodiscard]] static std::optional<grammar> parse_from_stream(
+        std::istream & input, diagnostics & diag = diagnostics::standard(),
+        size_t chunk_size = size_t{1} << 16u);
+    // Loads a grammar saved by write_binary, such as a mapped file.
+    // Nothing is tokenized, but the data is checked,
+    // so a truncated or corrupt file is reported rather than trusted.
+    [[nodiscard]] static std::optional<grammar> parse_binary(
+        std::string_view data, diagnostics & diag = diagnostics::standard());
+    // Saves the symbols and rules in the format described in binary_format.hpp
+    void write_binary(std::ostream & out) const;
+    // Writes the rules in the text format parse_from_file reads,
+    // one `X - a B | c ;` line for each nonterminal with alternatives.
+    // An initial symbol without any is written as `X - X ;`,
+    // which derives nothing either, so it is still read back first.
+    // The output is built up in large blocks and never flushed,
+    // so writing is cheap even for very large grammars.
+    void write_text(std::ostream & out) const;
     // Create a new grammar with the same nonterminals as the input
-    [[nodiscard]] static grammar copy_terminals_from(const grammar &);
+    [[nodiscard]] static grammar copy_terminals_from(
+        const grammar & input, diagnostics & diag = diagnostics::standard());
 
-    // Returns each rule as its own vector
-    [[nodiscard]] std::vector<std::vector<token_t>> rule_matrix(
-        token_t nonterminal) const;
+    // Returns every alternative of the nonterminal.
+    // Iterating over the result does not allocate.
+    [[nodiscard]] const productions_t & alternatives(token_t nonterminal) const;
 
     [[nodiscard]] auto nonterminal_count() const { return rules.size(); }
     [[maybe_unused]] [[nodiscard]] auto terminal_count() const {
@@ -56,27 +90,66 @@ class grammar {
 
     token_t get_terminal(const symbol_t & symbol);
 
+    // Only checks for a literal empty alternative
     [[nodiscard]] bool has_empty_production(token_t nonterminal) const;
 
+    // Every nonterminal can only be nullable if some nonterminal
+    // has a literal empty alternative
     [[nodiscard]] bool has_any_empty_production() const {
-        for (const auto nonterm : this->nonterminals())
-            if (this->has_empty_production(nonterm)) return true;
+        return nullable().any();
+    }
 
-        return false;
+    // The nonterminals which can derive the empty string,
+    // either directly or through other nullable nonterminals.
+    // Indexed by token.
+    // Computed in O(|grammar|) on first use
+    // and cached until the grammar is modified
+    [[nodiscard]] const dynamic_bitset & nullable() const;
+
+    [[nodiscard]] bool is_nullable(token_t nonterminal) const {
+        return nonterminal > 0
+               and nullable().test(static_cast<int>(nonterminal));
+    }
+
+    // The nonterminals which can derive some string of terminals.
+    // Indexed by token, computed and cached like nullable()
+    [[nodiscard]] const dynamic_bitset & productive() const;
+
+    [[nodiscard]] bool is_productive(token_t nonterminal) const {
+        return nonterminal > 0
+               and productive().test(static_cast<int>(nonterminal));
     }
 
+    // The nonterminals reachable from `start`, in the order they are found.
+    // If `only_productive` is set, alternatives mentioning an unproductive
+    // nonterminal are not followed. Runs in O(|grammar|).
+    [[nodiscard]] std::vector<token_t> reachable_from(
+        token_t start, bool only_productive = false) const;
+
     [[nodiscard]] bool in_some_production(const token_t & tok) const {
         for (const auto & entry : rules)
-            if (std::any_of(
-                    entry.second.begin(), entry.second.end(),
+            if (const auto & tokens = entry.second.all_tokens(); std::any_of(
+                    tokens.begin(), tokens.end(),
                     [&tok](const auto & token) { return tok == token; }))
                 return true;
 
         return false;
     }
 
+    // The graph of unit productions (A -> B, with A != B)
+    // and its strongly connected components.
+    // The vertices are the nonterminal tokens.
+    struct unit_graph {
+        digraph           graph;
+        strong_components components;
+    };
+
+    // Computed in O(|grammar|) on first use
+    // and cached until the grammar is modified
+    [[nodiscard]] const unit_graph & unit_productions() const;
+
     [[nodiscard]] bool has_any_cycle() const {
-        return not this->cyclic_path().empty();
+        return unit_productions().components.any_cyclic();
     }
 
     // Prints one possible cycle path
@@ -99,24 +172,89 @@ class grammar {
 
     [[nodiscard]] std::map<token_t, symbol_t> terminal_keys() const;
 
+    // The token must be in use
+    [[nodiscard]] const symbol_t & symbol_of(token_t token) const {
+        return symbols.at(token);
+    }
+
+    // The token of the symbol, if it is in use
+    [[nodiscard]] std::optional<token_t> token_of(
+        std::string_view symbol) const {
+        return symbols.find(symbol);
+    }
+
     // Returns true if the rule was successfully added
-    bool add_rule(const symbol_t & symbol, std::vector<token_t> && rule);
+    bool add_rule(const symbol_t & symbol, productions_t && rule);
+
+    // Replaces every alternative of the nonterminal,
+    // which must already have a token
+    void replace_alternatives(token_t nonterminal, productions_t && rule);
+
+    // Removes the nonterminal and its alternatives.
+    // It must not be used by any alternative that is left.
+    void erase_nonterminal(token_t nonterminal);
+
+    // Gives the symbol, which must be unused, a fresh nonterminal token.
+    // The new nonterminal has no alternatives.
+    token_t new_nonterminal(const symbol_t & symbol);
 
     token_t add_terminal(const symbol_t & symbol, token_t term);
 
     token_t add_nonterminal(const symbol_t & symbol, token_t nonterm);
 
-    // Helpers to get the next available item
+    // Helpers to get the next available item, in constant time
     [[nodiscard]] token_t next_nonterminal() const;
 
     [[nodiscard]] token_t next_terminal() const;
 
-    [[nodiscard]] symbol_t next_nonterminal_symbol() const;
+    // Returns an unused nonterminal symbol named after `origin`:
+    // <A_1>, <A_2>, ... for A or <A>.
+    // Each name has its own counter, so this is amortized constant time.
+    [[nodiscard]] symbol_t fresh_nonterminal_symbol(token_t origin);
 
    private:
     [[nodiscard]] explicit grammar() = default;
-    std::map<token_t, symbol_t> symbols{{rule_sep, rule_sep_char()}};
-    std::map<token_t, std::vector<token_t>> rules{};
+
+    // Parses whole statements from `data` into this grammar.
+    // Returns false if there was an error.
+    bool parse_statements(std::string_view data, size_t & line_num,
+                          diagnostics & diag);
+
+    // Like get_nonterminal and get_terminal,
+    // but the symbol is only copied if it is new
+    token_t intern_nonterminal(std::string_view symbol);
+    token_t intern_terminal(std::string_view symbol);
+
+    // Must be called by anything that modifies the symbols or rules
+    void invalidate_analyses() {
+        unit_cache.reset();
+        nullable_cache.reset();
+        productive_cache.reset();
+    }
+
+    // One past the largest token in use
+    [[nodiscard]] size_t token_space() const;
+
+    // Marks every nonterminal with an alternative made of marked nonterminals
+    // (and terminals, if they are allowed), until nothing changes.
+    [[nodiscard]] dynamic_bitset derivation_fixpoint(
+        bool terminals_allowed) const;
+
+    [[nodiscard]] static symbol_table<token_t, symbol_t> initial_symbols() {
+        symbol_table<token_t, symbol_t> to_ret{};
+        to_ret.emplace(rule_sep, rule_sep_char());
+        return to_ret;
+    }
+
+    symbol_table<token_t, symbol_t> symbols = initial_symbols();
+    std::map<token_t, productions_t> rules{};
+
+    // The last suffix handed out by fresh_nonterminal_symbol for each name
+    std::unordered_map<std::string, unsigned> fresh_suffixes{};
+
+    mutable std::optional<unit_graph>     unit_cache{};
+    mutable std::optional<dynamic_bitset> nullable_cache{};
+    mutable std::optional<dynamic_bitset> productive_cache{};
 
     friend std::ostream & operator<<(std::ostream & lhs, const grammar & rhs);
 };
@@ -0,0 +1,208 @@
+#include "grammar_generator.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+namespace {
+    class alternative_writer final {
+       public:
+        alternative_writer(const grammar_shape & shape, std::mt19937 & rng)
+            : shape{shape}
+            , rng{rng} {}
+
+        // True with the given probability
+        bool chance(double probability) {
+            return static_cast<double>(rng() % 1000) < probability * 1000;
+        }
+
+        std::string_view terminal() {
+            static constexpr std::string_view terminals
+                = "abcdefghijklmnopqrstuvwxyz";
+            return terminals.substr(rng() % terminals.size(), 1);
+        }
+
+        // Pads the alternative out to the rule length with a random mix of
+        // terminals and nonterminals
+        void fill(std::ostream & out, size_t written) {
+            for (; written < shape.rule_length; ++written) {
+                out << ' ';
+                if (rng() % 2 == 0)
+                    nonterminal(out, rng() % shape.nonterminal_count);
+                else
+                    out << terminal();
+            }
+        }
+
+        static void nonterminal(std::ostream & out, size_t index) {
+            out << "<N" << index << '>';
+        }
+
+       private:
+        const grammar_shape & shape;
+        std::mt19937 &        rng;
+    };
+}  // namespace
+
+std::string generate_grammar(const grammar_shape & shape) {
+    const auto count = shape.nonterminal_count;
+    if (count == 0) return {};
+
+    std::mt19937       rng{shape.seed};
+    alternative_writer writer{shape, rng};
+
+    // Which nonterminals start a left recursive pair with their successor.
+    // Pairs never overlap, so each nonterminal is in at most one.
+    std::vector<bool> pair_start(count, false);
+    for (size_t index = 0; index + 1 < count; index += 2)
+        pair_start[index] = writer.chance(shape.left_recursion);
+
+    std::ostringstream out;
+    for (size_t index = 0; index < count; ++index) {
+        alternative_writer::nonterminal(out, index);
+        out << " -";
+
+        // Every alternative but the first is preceded by a separator
+        const char * separator = "";
+        const auto   next_alternative
+            = [&out, &separator]() -> std::ostream & {
+            out << separator;
+            separator = " |";
+            return out;
+        };
+
+        // Keeps the next nonterminal reachable
+        next_alternative() << ' ' << writer.terminal();
+        if (index + 1 < count) {
+            out << ' ';
+            alternative_writer::nonterminal(out, index + 1);
+            writer.fill(out, 2);
+        } else {
+            writer.fill(out, 1);
+        }
+
+        // Keeps this nonterminal productive
+        next_alternative();
+        for (size_t pos = 0; pos < std::max<size_t>(shape.rule_length, 1);
+             ++pos)
+            out << ' ' << writer.terminal();
+
+        // Starting with a terminal keeps these out of any left recursion
+        for (size_t alt = 2; alt < shape.alternatives; ++alt) {
+            next_alternative() << ' ' << writer.terminal();
+            writer.fill(out, 1);
+        }
+
+        // A -> B x ; B -> A y
+        if (const bool first = pair_start[index],
+            second = index > 0 and pair_start[index - 1];
+            first or second) {
+            next_alternative() << ' ';
+            alternative_writer::nonterminal(out, first ? index + 1 : index - 1);
+            out << ' ' << writer.terminal();
+            writer.fill(out, 2);
+        }
+
+        // Chains of unit productions, broken every unit_chain_depth links
+        if (const auto depth = shape.unit_chain_depth;
+            depth != 0 and index + 1 < count
+            and index % (depth + 1) != depth) {
+            next_alternative() << ' ';
+            alternative_writer::nonterminal(out, index + 1);
+        }
+
+        // An empty alternative has nothing after its separator
+        if (writer.chance(shape.nullable)) next_alternative();
+
+        out << " ;\n";
+    }
+
+    return out.str();
+}
+
+std::vector<std::vector<grammar::token_t>> generate_sentences(
+    const grammar & input, size_t count, size_t length, std::uint32_t seed) {
+    using token_t = grammar::token_t;
+
+    const std::vector nonterms = input.nonterminals();
+    const auto        slots
+        = static_cast<size_t>(static_cast<int>(input.next_nonterminal()));
+
+    // The fewest terminals each nonterminal derives, and the alternative
+    // which does it. An alternative only replaces one which is strictly
+    // longer, so following the shortest alternatives always ends.
+    constexpr auto          unproductive = std::numeric_limits<size_t>::max();
+    std::vector<size_t>     shortest(slots, unproductive);
+    std::vector<size_t>     shortest_alternative(slots, 0);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto nonterm : nonterms) {
+            const auto & rules = input.alternatives(nonterm);
+            for (size_t alt = 0; alt < rules.size(); ++alt) {
+                size_t total = 0;
+                for (const auto token : rules[alt]) {
+                    const auto cost
+                        = token < 0 ? 1 : shortest[static_cast<int>(token)];
+                    total = cost == unproductive ? unproductive : total + cost;
+                    if (total == unproductive) break;
+                }
+
+                auto & best = shortest[static_cast<int>(nonterm)];
+                if (total < best) {
+                    best = total;
+                    shortest_alternative[static_cast<int>(nonterm)] = alt;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<token_t>> to_ret{};
+    const auto                        start = nonterms.front();
+    if (shortest[static_cast<int>(start)] == unproductive) return to_ret;
+
+    std::mt19937         rng{seed};
+    std::vector<token_t> stack{};
+    std::vector<size_t>  choices{};
+    for (size_t index = 0; index < count; ++index) {
+        auto & sentence = to_ret.emplace_back();
+        stack.assign(1, start);
+
+        while (not stack.empty()) {
+            const auto top = stack.back();
+            stack.pop_back();
+            if (top < 0) {
+                sentence.push_back(top);
+                continue;
+            }
+
+            // Only alternatives which derive something can be chosen.
+            // Symbols waiting on the stack count towards the length,
+            // so left recursion cannot grow the stack without end.
+            const auto & rules  = input.alternatives(top);
+            auto         chosen = shortest_alternative[static_cast<int>(top)];
+            if (sentence.size() + stack.size() < length) {
+                choices.clear();
+                for (size_t alt = 0; alt < rules.size(); ++alt)
+                    if (std::all_of(rules[alt].begin(), rules[alt].end(),
+                                    [&shortest](token_t token) {
+                                        return token < 0
+                                               or shortest[static_cast<int>(
+                                                      token)]
+                                                      != unproductive;
+                                    }))
+                        choices.push_back(alt);
+                chosen = choices[rng() % choices.size()];
+            }
+
+            const auto rule = rules[chosen];
+            for (auto pos = rule.size(); pos-- > 0;)
+                stack.push_back(rule[pos]);
+        }
+    }
+
+    return to_ret;
+}
@@ -0,0 +1,47 @@
+#ifndef GRAMMAR_GENERATOR_HPP
+#define GRAMMAR_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "grammar.hpp"
+
+// The parameters of a synthetic grammar.
+// Every nonterminal is named <N0>, <N1>, ... and <N0> is the initial symbol.
+struct grammar_shape {
+    size_t nonterminal_count = 1000;
+    // Ordinary alternatives of every nonterminal, at least two:
+    // one keeps the next nonterminal reachable
+    // and one keeps this nonterminal productive.
+    // The features below add alternatives on top of these.
+    size_t alternatives = 3;
+    // Symbols in each ordinary alternative
+    size_t rule_length = 4;
+    // Fraction of nonterminals which are indirectly left recursive,
+    // through a pair A -> B x ; B -> A y
+    double left_recursion = 0.1;
+    // Fraction of nonterminals with an empty alternative
+    double nullable = 0.1;
+    // Length of the chains A_1 -> A_2 -> ... of unit productions.
+    // 0 means there are no unit productions.
+    size_t unit_chain_depth = 2;
+    // The same shape and seed always give the same grammar
+    std::uint32_t seed = 1;
+};
+
+// Writes a grammar of the given shape in the input format of grammar::parse_*.
+// Every nonterminal is reachable from <N0> and can derive a terminal string.
+[[nodiscard]] std::string generate_grammar(const grammar_shape & shape);
+
+// Derives `count` random strings of terminals from the initial symbol of
+// `input`, the nonterminal with the smallest token.
+// Once a string has `length` terminals and symbols still to expand,
+// every nonterminal left takes its shortest way to terminals,
+// so the strings stay around that length.
+// Returns nothing if the initial symbol cannot derive any string.
+[[nodiscard]] std::vector<std::vector<grammar::token_t>> generate_sentences(
+    const grammar & input, size_t count, size_t length, std::uint32_t seed);
+
+#endif
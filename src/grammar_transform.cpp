@@ -2,10 +2,18 @@
 #include "grammar_transform.hpp"
 
 #include <algorithm>
-#include <iostream>
-#include <set>
-
-using token_t = grammar::token_t;
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using token_t       = grammar::token_t;
+using productions_t = grammar::productions_t;
 
 // A template to help with checking if a container contains an item
 template<typename T, typename Iter>
@@ -13,45 +21,127 @@ bool contains(Iter begin, Iter end, T item) {
     return std::find(begin, end, item) != end;
 }
 
-std::optional<grammar> remove_left_recursion(const grammar & input) {
-    // Preconditions: input has no empty productions and no cycles
+namespace {
+    // remove_left_recursion needs a grammar with no empty productions
+    // and no cycles
+    bool left_recursion_preconditions(const grammar & input,
+                                      diagnostics &   diag) {
+        if (input.has_any_empty_production()) {
+            diag.error("Input grammar has an empty production.\n");
+            return false;
+        }
+
+        if (const auto cycle = input.cyclic_path(); !cycle.empty()) {
+            diag.error("Input grammar has a cycle:\n");
+            bool first = true;
+            for (const auto & entry : cycle) {
+                if (first) {
+                    first = false;
+                } else {
+                    diag.error(" --> ");
+                }
+                diag.error(entry);
+            }
+
+            diag.error('\n');
+            return false;
+        }
 
-    if (input.has_any_empty_production()) {
-        std::cerr << "Input grammar has an empty production.\n";
-        return {};
+        return true;
     }
 
-    if (const auto cycle = input.cyclic_path(); !cycle.empty()) {
-        std::cerr << "Input grammar has a cycle:\n";
-        bool first = true;
-        for (const auto & entry : cycle) {
-            if (first) {
-                first = false;
-            } else {
-                std::cerr << " --> ";
+    // Gives A_i the alternatives in `result_matrix`, which are its own
+    // with the earlier nonterminals substituted in, and removes any
+    // immediate left recursion that leaves.
+    // `fresh_symbol`, if given, names the nonterminal made to remove
+    // immediate left recursion, instead of a new fresh symbol.
+    // Returns that nonterminal, if one was needed.
+    // `result_matrix` must already be charged to `budget`.
+    std::optional<token_t> finish_nonterminal(
+        grammar & output, token_t nonterm_i,
+        const productions_t & result_matrix, bool substituted,
+        diagnostics & diag, resource_budget & budget,
+        std::optional<grammar::symbol_t> fresh_symbol) {
+        // At this point, the rule matrix is definitely full of rules.
+        // Either a rule had to have left recursion removed
+        // or it was copied wholesale from the input grammar.
+
+        if (diag.enabled(log_level::verbose)) {
+            diag.verbose("Before immediate recursion removal for nonterm ",
+                         nonterm_i, "(sym ", output.symbol_of(nonterm_i),
+                         "):\n");
+            for (const auto row : result_matrix) {
+                for (const auto & item : row) diag.verbose(' ', item);
+                diag.verbose('\n');
+            }
+        }
+
+        // Remove immediate left recursion
+        const bool has_left_recursion = std::any_of(
+            result_matrix.begin(), result_matrix.end(),
+            [&nonterm_i](const auto & rule) {
+                return not rule.empty() and rule.front() == nonterm_i;
+            });
+
+        if (has_left_recursion) {
+            const auto new_nonterm = output.new_nonterminal(
+                fresh_symbol ? *fresh_symbol
+                             : output.fresh_nonterminal_symbol(nonterm_i));
+
+            productions_t full_rule_i;
+            productions_t full_rule_new;
+
+            // The new symbol starts with the empty production
+            full_rule_new.start_alternative();
+
+            for (const auto rule : result_matrix) {
+                if (not rule.empty() and rule.front() == nonterm_i) {
+                    // skip the first element, copy the left recursive rule into
+                    // the new symbol
+                    full_rule_new.add_alternative(rule.subview(1));
+                    full_rule_new.append(new_nonterm);
+                } else {
+                    full_rule_i.add_alternative(rule);
+                    full_rule_i.append(new_nonterm);
+                }
             }
-            std::cerr << entry;
+
+            budget.grow(nonterm_i, full_rule_i.size() + full_rule_new.size(),
+                        full_rule_i.token_count()
+                            + full_rule_new.token_count());
+            budget.shrink(result_matrix.size(), result_matrix.token_count());
+
+            output.replace_alternatives(nonterm_i, std::move(full_rule_i));
+            output.replace_alternatives(new_nonterm, std::move(full_rule_new));
+            return new_nonterm;
         }
 
-        std::cerr << '\n';
-        return {};
+        if (substituted) {
+            // Copied rather than moved, so that the capacity stays here
+            output.replace_alternatives(nonterm_i,
+                                        productions_t{result_matrix});
+        }
+        return std::optional<token_t>{};
     }
 
-    auto              output             = grammar::copy_terminals_from(input);
-    const auto        input_nonterm_keys = input.nonterminal_keys();
-    const std::vector nonterms           = input.nonterminals();
+    // Rewrites the alternatives of A_i = nonterms[i].
+    // The nonterminals before A_i must already have their final alternatives.
+    // Each alternative has at most one nonterminal substituted into it.
+    std::optional<token_t> rewrite_nonterminal(
+        grammar & output, const std::vector<token_t> & nonterms, size_t i,
+        productions_t & result_matrix, diagnostics & diag,
+        resource_budget & budget,
+        std::optional<grammar::symbol_t> fresh_symbol = {}) {
+        result_matrix.clear();
 
-    for (const auto & entry : input.nonterminal_keys())
-        if (output.add_nonterminal(entry.second, entry.first) != entry.first)
-            std::cout << entry.second << " has been remapped\n";
+        const auto   nonterm_i   = nonterms.at(i);
+        const auto & rules_i     = output.alternatives(nonterm_i);
+        bool         substituted = false;
 
-    for (auto i = 0ul; i < nonterms.size(); i++) {
-        auto         nonterm_i     = nonterms.at(i);
-        const auto   rule_matrix_i = input.rule_matrix(nonterm_i);
-        const auto & nonterm_i_sym = input_nonterm_keys.at(nonterm_i);
-        std::vector<std::vector<token_t>> result_matrix{};
+        // The budget holds the alternatives being made instead
+        budget.shrink(rules_i.size(), rules_i.token_count());
 
-        for (const auto & rule_i : rule_matrix_i) {
+        for (const auto rule_i : rules_i) {
             bool removed_recursion = false;
 
             if (i != 0)
@@ -61,288 +151,847 @@ std::optional<grammar> remove_left_recursion(const grammar & input) {
                     // Replace A_i -> A_j g with A_i -> d_n g where A_j -> d_n
                     // As there are no epsilon rules, front() can be used with
                     // impunity.
-                    if (std::vector<token_t> result_rule;
-                        rule_i.front() == nonterm_j) {
-                        const auto rule_matrix_j
-                            = output.rule_matrix(nonterm_j);
-                        for (const auto & rule_j : rule_matrix_j) {
-                            std::copy(rule_j.cbegin(), rule_j.cend(),
-                                      std::back_inserter(result_rule));
-
-                            bool first = true;
-                            for (const auto & item : rule_i)
-                                if (first)
-                                    first = false;
-                                else
-                                    result_rule.push_back(item);
-
-                            result_matrix.push_back(std::move(result_rule));
-                            result_rule = {};
+                    if (rule_i.front() == nonterm_j) {
+                        for (const auto rule_j :
+                             output.alternatives(nonterm_j)) {
+                            result_matrix.add_alternative(rule_j);
+                            for (const auto & item : rule_i.subview(1))
+                                result_matrix.append(item);
+                            budget.grow(nonterm_i, 1,
+                                        rule_j.size() + rule_i.size() - 1);
                         }
                         removed_recursion = true;
                     }
                 }
 
-            if (not removed_recursion) result_matrix.push_back(rule_i);
+            if (not removed_recursion) {
+                result_matrix.add_alternative(rule_i);
+                budget.grow(nonterm_i, 1, rule_i.size());
+            }
+            substituted |= removed_recursion;
         }
 
-        // At this point, the rule matrix is definitely full of rules.
-        // Either a rule had to have left recursion removed
-        // or it was copied wholesale from the input grammar.
+        return finish_nonterminal(output, nonterm_i, result_matrix,
+                                  substituted, diag, budget,
+                                  std::move(fresh_symbol));
+    }
 
-        std::cout << "Before immediate recursion removal for nonterm "
-                  << nonterm_i << "(sym " << nonterm_i_sym << "):\n";
-        for (auto & row : result_matrix) {
-            for (auto & item : row) std::cout << ' ' << item;
-            std::cout << '\n';
+    // Translates between the symbol indices of a cache and the tokens of
+    // the grammar being rewritten, and numbers the grammar's symbols for
+    // the next cache. Each cached symbol is only looked up once.
+    class cache_symbols final {
+       public:
+        using index_t = left_recursion_cache::index_t;
+        using rules_t = left_recursion_cache::rules_t;
+
+        cache_symbols(const grammar &                  output,
+                      const std::vector<std::string> & cached)
+            : output{output}
+            , cached{cached}
+            , tokens(cached.size(), grammar::rule_sep)
+            , first_token{static_cast<int>(output.next_terminal()) + 1} {}
+
+        // The token for a cached symbol,
+        // or rule_sep if the grammar does not have it (yet)
+        [[nodiscard]] token_t token(index_t index) {
+            auto & to_ret = tokens[index];
+            if (to_ret == grammar::rule_sep and not cached[index].empty())
+                to_ret = output.token_of(cached[index])
+                             .value_or(grammar::rule_sep);
+            return to_ret;
         }
 
-        // Remove immediate left recursion
-        const bool has_left_recursion = std::any_of(
-            result_matrix.begin(), result_matrix.end(),
-            [&nonterm_i](const auto & rule) {
-                return not rule.empty() and rule.front() == nonterm_i;
-            });
+        [[nodiscard]] bool matches(const rules_t &       rules,
+                                   const productions_t & alternatives) {
+            if (rules.size() != alternatives.size()) return false;
+            for (size_t alt = 0; alt < rules.size(); ++alt) {
+                const auto rule = rules[alt];
+                const auto current = alternatives[alt];
+                if (rule.size() != current.size()) return false;
+                for (size_t pos = 0; pos < rule.size(); ++pos)
+                    if (token(rule[pos]) != current[pos]) return false;
+            }
+            return true;
+        }
 
-        if (has_left_recursion) {
-            const auto new_nonterm_sym = output.next_nonterminal_symbol();
-            const auto new_nonterm     = output.next_nonterminal();
-
-            if (auto remapped_nonterm_i = output.get_nonterminal(nonterm_i_sym);
-                remapped_nonterm_i != nonterm_i) {
-                std::cout << nonterm_i_sym << " has been remapped to "
-                          << remapped_nonterm_i << std::endl;
-                nonterm_i = remapped_nonterm_i;
+        // Returns nothing if some symbol is not in the grammar.
+        // `fresh` is the one symbol which is not in the grammar yet,
+        // and is given the token `fresh_token`.
+        [[nodiscard]] std::optional<productions_t> translate(
+            const rules_t & rules, index_t fresh, token_t fresh_token) {
+            productions_t to_ret{};
+            to_ret.reserve(rules.size(), rules.all_tokens().size());
+            for (const auto rule : rules) {
+                to_ret.start_alternative();
+                for (const auto index : rule) {
+                    const auto current
+                        = index == fresh ? fresh_token : token(index);
+                    if (current == grammar::rule_sep)
+                        return std::optional<productions_t>{};
+                    to_ret.append(current);
+                }
             }
+            return to_ret;
+        }
 
-            std::vector<token_t> full_rule_i;
-            std::vector<token_t> full_rule_new;
+        // Tokens are never erased while the pass runs,
+        // so the next cache numbers them from the smallest
+        [[nodiscard]] index_t index_of(token_t token) const {
+            return static_cast<index_t>(static_cast<int>(token) - first_token);
+        }
 
-            for (const auto & rule : result_matrix) {
-                if (rule.empty())
-                    full_rule_i.push_back(grammar::rule_sep);
-                else if (rule.front() == nonterm_i) {
-                    bool first = true;
-                    full_rule_new.push_back(grammar::rule_sep);
-                    // skip the first element, copy the left recursive rule into
-                    // the new symbol
-                    for (auto token : rule)
-                        if (not first)
-                            full_rule_new.push_back(token);
-                        else
-                            first = false;
+        [[nodiscard]] rules_t indices_of(
+            const productions_t & alternatives) const {
+            rules_t to_ret{};
+            to_ret.reserve(alternatives.size(),
+                           alternatives.all_tokens().size());
+            for (const auto rule : alternatives) {
+                to_ret.start_alternative();
+                for (const auto token : rule) to_ret.append(index_of(token));
+            }
+            return to_ret;
+        }
 
-                    full_rule_new.push_back(new_nonterm);
-                } else {
-                    if (not full_rule_i.empty()
-                        and full_rule_i.back() != grammar::rule_sep)
-                        full_rule_i.push_back(grammar::rule_sep);
+        // The symbols for the next cache, once the pass is done
+        [[nodiscard]] std::vector<std::string> next_symbols() const {
+            std::vector<std::string> to_ret(
+                index_of(output.next_nonterminal()));
+            for (const auto & list :
+                 {output.terminals(), output.nonterminals()})
+                for (const auto token : list)
+                    to_ret[index_of(token)] = static_cast<const std::string &>(
+                        output.symbol_of(token));
+            return to_ret;
+        }
 
-                    for (auto token : rule) full_rule_i.push_back(token);
+       private:
+        const grammar &                  output;
+        const std::vector<std::string> & cached;
+        std::vector<token_t>             tokens;
+        int                              first_token;
+    };
+}  // namespace
 
-                    full_rule_i.push_back(new_nonterm);
-                }
-            }
+std::optional<grammar> remove_left_recursion(grammar        input,
+                                             pass_context & ctx) {
+    auto & diag = ctx.diag;
+    instrumentation::scope pass{ctx.stats, "remove_left_recursion", input,
+                                ctx.pool};
 
-            output.add_rule(nonterm_i_sym, std::move(full_rule_i));
-            output.add_rule(new_nonterm_sym, std::move(full_rule_new));
+    if (not left_recursion_preconditions(input, diag)) return {};
 
-        } else {
-            std::vector<token_t> full_rule;
-            bool                 first = true;
-            for (const auto & rule : result_matrix) {
-                if (first)
-                    first = false;
-                else
-                    full_rule.push_back(grammar::rule_sep);
+    // The nonterminals are rewritten in place, in token order.
+    // Those before A_i already have their final alternatives,
+    // while A_i and those after it still have their original ones.
+    auto              output   = std::move(input);
+    const std::vector nonterms = output.nonterminals();
+    resource_budget   budget{ctx.limits, "remove_left_recursion", output};
 
-                for (auto sym : rule) full_rule.push_back(sym);
-            }
+    // Reused for every nonterminal, so it only grows a few times per pass
+    productions_t result_matrix{};
 
-            output.add_rule(nonterm_i_sym, std::move(full_rule));
-        }
+    for (auto i = 0ul; i < nonterms.size(); i++) {
+        pass.iteration();
+        rewrite_nonterminal(output, nonterms, i, result_matrix, diag, budget);
     }
 
-    return std::optional{output};
+    pass.finish(output);
+    return std::optional{std::move(output)};
 }
 
-grammar make_proper_form(const grammar & input) {
-    // TODO: remove unproductive symbols?
-    return remove_unreachables(remove_unit_productions(remove_epsilon(input)));
-}
-
-grammar remove_epsilon(const grammar & input) {
-    if (not input.has_any_empty_production()) return input;
+std::optional<grammar> remove_left_recursion(grammar                input,
+                                             left_recursion_cache & cache,
+                                             pass_context &         ctx) {
+    auto & diag = ctx.diag;
+    instrumentation::scope pass{ctx.stats, "remove_left_recursion", input,
+                                ctx.pool};
+
+    if (not left_recursion_preconditions(input, diag)) return {};
+
+    auto              output   = std::move(input);
+    const std::vector nonterms = output.nonterminals();
+    resource_budget   budget{ctx.limits, "remove_left_recursion", output};
+
+    cache_symbols symbols{output, cache.symbols()};
+
+    // The cached entry for each nonterminal, by position
+    std::vector<const left_recursion_cache::entry *> cached(nonterms.size());
+    for (const auto & entry : cache.entries()) {
+        const auto token = symbols.token(entry.nonterminal);
+        const auto position
+            = std::lower_bound(nonterms.begin(), nonterms.end(), token);
+        if (token != grammar::rule_sep and position != nonterms.end()
+            and *position == token)
+            cached[position - nonterms.begin()] = &entry;
+    }
 
-    auto              output             = grammar::copy_terminals_from(input);
-    const auto        input_nonterm_keys = input.nonterminal_keys();
-    const std::vector nonterms           = input.nonterminals();
+    // Whether each nonterminal, by position, has a different result
+    // from the cached one, so everything substituting it must be redone
+    std::vector<bool> changed(nonterms.size(), false);
 
-    // If the first symbol has epsilon, check if it is used anywhere
-    if (input.has_empty_production(nonterms.front())) {
-        if (input.in_some_production(nonterms.front())) {
-            // Since the initial symbol is used somewhere in the grammar
-            // and it can generate empty,
-            // the grammmar must be augmented.
+    std::vector<left_recursion_cache::entry> entries{};
+    entries.reserve(nonterms.size());
 
-            // This is done in the form B -> A | empty ; A -> a_1 | a_2
-            // where the original rule was A -> empty | a_1 | a_2
+    productions_t        result_matrix{};
+    std::vector<token_t> dependencies{};
+    size_t               reused = 0;
 
-            const auto & initial_sym = input_nonterm_keys.at(nonterms.front());
+    for (auto i = 0ul; i < nonterms.size(); i++) {
+        pass.iteration();
+
+        const auto   nonterm_i = nonterms[i];
+        const auto * entry     = cached[i];
+
+        left_recursion_cache::entry current{};
+        current.nonterminal = symbols.index_of(nonterm_i);
+        current.input
+            = symbols.indices_of(output.alternatives(nonterm_i));
+
+        // The nonterminals before A_i, which are substituted into it.
+        // nonterms is in token order, so it can be searched.
+        dependencies.clear();
+        bool dependency_changed = false;
+        for (const auto rule : output.alternatives(nonterm_i)) {
+            const auto front = std::lower_bound(
+                nonterms.begin(), nonterms.begin() + i, rule.front());
+            if (front == nonterms.begin() + i or *front != rule.front()
+                or contains(dependencies.begin(), dependencies.end(), *front))
+                continue;
+
+            dependencies.push_back(*front);
+            dependency_changed |= changed[front - nonterms.begin()];
+        }
 
-            auto initial
-                = output.add_nonterminal(initial_sym, nonterms.front());
+        bool reuse = entry != nullptr and not dependency_changed
+                     and entry->dependencies.size() == dependencies.size()
+                     and symbols.matches(entry->input,
+                                         output.alternatives(nonterm_i));
+        for (size_t dep = 0; reuse and dep < dependencies.size(); ++dep)
+            reuse = symbols.token(entry->dependencies[dep])
+                    == dependencies[dep];
+
+        // The fresh symbol must be the one a full run would choose,
+        // so the output does not depend on what was cached
+        std::optional<grammar::symbol_t> fresh_symbol{};
+        if (reuse and entry->fresh != left_recursion_cache::no_symbol) {
+            fresh_symbol = output.fresh_nonterminal_symbol(nonterm_i);
+            reuse = static_cast<const std::string &>(*fresh_symbol)
+                    == cache.symbols()[entry->fresh];
+        }
 
-            // The new symbol added from the augmentation
-            auto true_initial_sym = output.next_nonterminal_symbol();
-            output.add_nonterminal(true_initial_sym, output.next_nonterminal());
+        std::optional<productions_t> alternatives{};
+        std::optional<productions_t> fresh_alternatives{};
+        if (reuse) {
+            const auto fresh_token = output.next_nonterminal();
+            alternatives
+                = symbols.translate(entry->output, entry->fresh, fresh_token);
+            if (fresh_symbol)
+                fresh_alternatives = symbols.translate(
+                    entry->fresh_output, entry->fresh, fresh_token);
+            reuse = alternatives and (not fresh_symbol or fresh_alternatives);
+        }
 
-            output.add_rule(true_initial_sym,
-                            std::vector<token_t>{initial, grammar::rule_sep});
+        std::optional<token_t> fresh{};
+        if (reuse) {
+            ++reused;
+            const auto & old_rules = output.alternatives(nonterm_i);
+            budget.shrink(old_rules.size(), old_rules.token_count());
+            budget.grow(nonterm_i, alternatives->size(),
+                        alternatives->token_count());
+
+            if (fresh_symbol) {
+                budget.grow(nonterm_i, fresh_alternatives->size(),
+                            fresh_alternatives->token_count());
+                fresh = output.new_nonterminal(*fresh_symbol);
+                output.replace_alternatives(*fresh,
+                                            std::move(*fresh_alternatives));
+            }
+            output.replace_alternatives(nonterm_i, std::move(*alternatives));
+        } else {
+            fresh = rewrite_nonterminal(output, nonterms, i, result_matrix,
+                                        diag, budget, fresh_symbol);
+            changed[i] = entry == nullptr
+                         or not symbols.matches(entry->output,
+                                                output.alternatives(nonterm_i));
+        }
 
-            std::cout << "Grammar has been augmented\n";
+        for (const auto dependency : dependencies)
+            current.dependencies.push_back(symbols.index_of(dependency));
+        current.output = symbols.indices_of(output.alternatives(nonterm_i));
+        if (fresh) {
+            current.fresh = symbols.index_of(*fresh);
+            current.fresh_output
+                = symbols.indices_of(output.alternatives(*fresh));
         }
+        entries.push_back(std::move(current));
     }
 
-    // For every rule with a nonterminal that can be epsilon in it,
-    // that rule is duplicated and the copy has the nonterminal removed
-    std::set<token_t> to_remove;
-    for (const auto & nonterm : nonterms)
-        if (input.has_empty_production(nonterm)) to_remove.emplace(nonterm);
-
-    for (const auto & nonterm : nonterms) {
-        auto rule_matrix = input.rule_matrix(nonterm);
-        rule_matrix.reserve(rule_matrix.size() + to_remove.size());
-
-        for (auto & rule : rule_matrix)
-            for (const auto & removing : to_remove)
-                if (const auto loc
-                    = std::find(rule.begin(), rule.end(), removing);
-                    loc != rule.end()) {
-                    rule_matrix.emplace_back(rule);
-                    rule.erase(loc);
+    cache.replace(symbols.next_symbols(), std::move(entries));
+    diag.info("Reused the results of ", reused, " of ", nonterms.size(),
+              " nonterminals\n");
+
+    pass.finish(output);
+    return std::optional{std::move(output)};
+}
+
+std::optional<grammar> remove_left_recursion_by_components(
+    grammar input, pass_context & ctx) {
+    auto & diag = ctx.diag;
+    instrumentation::scope pass{ctx.stats,
+                                "remove_left_recursion_by_components", input,
+                                ctx.pool};
+
+    if (not left_recursion_preconditions(input, diag)) return {};
+
+    auto            output = std::move(input);
+    resource_budget budget{ctx.limits, "remove_left_recursion_by_components",
+                           output};
+
+    // A -> B g makes B a left corner of A.
+    // Left recursion is exactly a cycle of left corners.
+    std::vector<std::pair<digraph::vertex_t, digraph::vertex_t>> edges{};
+    for (const auto nonterm : output.nonterminals())
+        for (const auto rule : output.alternatives(nonterm))
+            if (rule.front() > 0)
+                edges.emplace_back(static_cast<int>(nonterm),
+                                   static_cast<int>(rule.front()));
+
+    const digraph left_corners{
+        static_cast<size_t>(static_cast<int>(output.next_nonterminal())),
+        edges};
+    const auto components = find_strong_components(left_corners);
+
+    productions_t        result_matrix{};
+    productions_t        pending{};
+    productions_t        next_pending{};
+    std::vector<token_t> members{};
+
+    // Substitution never leaves a component, so the components can be done
+    // in any order. They are done in the order they are numbered,
+    // which puts every component after those it has left corners in.
+    for (size_t component = 0; component < components.count(); ++component) {
+        if (not components.cyclic[component]) continue;
+
+        // Within a component, the nonterminals are done in token order,
+        // like remove_left_recursion does for the whole grammar
+        members.clear();
+        for (auto member = components.member_starts[component];
+             member < components.member_starts[component + 1]; ++member)
+            members.emplace_back(
+                static_cast<int>(components.members[member]));
+        std::sort(members.begin(), members.end());
+
+        for (size_t i = 0; i < members.size(); ++i) {
+            pass.iteration();
+
+            const auto nonterm_i   = members[i];
+            const auto earlier_end = members.begin() + i;
+            const auto is_earlier  = [&members, earlier_end](token_t token) {
+                return std::binary_search(members.begin(), earlier_end, token);
+            };
+
+            result_matrix.clear();
+            pending.clear();
+            pending.append_alternatives(output.alternatives(nonterm_i));
+            bool substituted = false;
+
+            // Replace A_i -> A_j g with A_i -> d_n g where A_j -> d_n,
+            // until no alternative starts with an earlier A_j.
+            // Each A_j only starts with later nonterminals,
+            // so this takes at most i rounds.
+            while (not pending.empty()) {
+                next_pending.clear();
+                for (const auto rule : pending) {
+                    if (not is_earlier(rule.front())) {
+                        result_matrix.add_alternative(rule);
+                        continue;
+                    }
+
+                    substituted = true;
+                    budget.shrink(1, rule.size());
+                    for (const auto rule_j :
+                         output.alternatives(rule.front())) {
+                        next_pending.add_alternative(rule_j);
+                        for (const auto & item : rule.subview(1))
+                            next_pending.append(item);
+                        budget.grow(nonterm_i, 1,
+                                    rule_j.size() + rule.size() - 1);
+                    }
                 }
+                std::swap(pending, next_pending);
+            }
 
-        std::vector<token_t> final_rule{};
-        bool                 first = true;
-        for (const auto & rule : rule_matrix) {
-            if (rule.empty()) continue;
+            finish_nonterminal(output, nonterm_i, result_matrix, substituted,
+                               diag, budget,
+                               std::optional<grammar::symbol_t>{});
+        }
+    }
+
+    pass.finish(output);
+    return std::optional{std::move(output)};
+}
 
-            if (first)
-                first = false;
-            else
-                final_rule.push_back(grammar::rule_sep);
+grammar make_proper_form(grammar input, pass_context & ctx) {
+    return remove_useless(
+        remove_unit_productions(remove_epsilon(std::move(input), ctx), ctx),
+        ctx);
+}
 
-            for (const auto & tok : rule) final_rule.push_back(tok);
+grammar left_factor(grammar input, pass_context & ctx) {
+    scratch_arena::pass_scope scratch{ctx.scratch};
+
+    auto & diag = ctx.diag;
+    instrumentation::scope pass{ctx.stats, "left_factor", input, ctx.pool};
+
+    auto              output   = std::move(input);
+    const std::vector nonterms = output.nonterminals();
+    resource_budget   budget{ctx.limits, "left_factor", output};
+    const auto        before = grammar_size::of(output);
+
+    // The prefix trie of one nonterminal's alternatives.
+    // Node 0 is the root, the empty prefix. Each node's children are
+    // linked in the order they were added, and found by hashing.
+    static constexpr std::uint32_t no_node = UINT32_MAX;
+    struct trie_node {
+        token_t       token{grammar::rule_sep};
+        bool          ends        = false;
+        std::uint32_t child_count = 0;
+        std::uint32_t first_child = no_node;
+        std::uint32_t last_child  = no_node;
+        std::uint32_t next        = no_node;
+    };
+
+    auto * const                arena = ctx.scratch.resource();
+    std::pmr::vector<trie_node> trie{arena};
+
+    // The nodes which start the alternatives of a nonterminal,
+    // which is either the one being factored or a fresh one
+    std::vector<std::pair<std::uint32_t, token_t>> pending{};
+    productions_t                                  factored{};
+    size_t                                         fresh_count = 0;
+
+    for (const auto nonterm : nonterms) {
+        pass.iteration();
+        budget.check(nonterm);
+
+        const auto & rules = output.alternatives(nonterm);
+        if (rules.size() < 2) continue;
+
+        // Clearing a map takes as long as its largest size,
+        // so each nonterminal has a map of its own
+        std::pmr::unordered_map<std::uint64_t, std::uint32_t> children{
+            rules.token_count(), arena};
+
+        trie.assign(1, trie_node{});
+        bool duplicate = false;
+        for (const auto rule : rules) {
+            std::uint32_t node = 0;
+            for (const auto token : rule) {
+                const auto key
+                    = (std::uint64_t{node} << 32u)
+                      | static_cast<std::uint32_t>(static_cast<int>(token));
+                const auto [child, added] = children.try_emplace(
+                    key, static_cast<std::uint32_t>(trie.size()));
+                if (added) {
+                    trie.push_back(trie_node{token});
+                    auto & parent = trie[node];
+                    if (parent.child_count++ == 0)
+                        parent.first_child = child->second;
+                    else
+                        trie[parent.last_child].next = child->second;
+                    parent.last_child = child->second;
+                }
+                node = child->second;
+            }
+            duplicate |= trie[node].ends;
+            trie[node].ends = true;
         }
 
-        output.add_rule(input_nonterm_keys.at(nonterm), std::move(final_rule));
+        // Without a shared prefix, every token has a node of its own
+        if (not duplicate and trie.size() - 1 == rules.token_count()) continue;
+
+        // The budget holds the alternatives being made instead
+        budget.shrink(rules.size(), rules.token_count());
+
+        pending.assign(1, {0, nonterm});
+        for (size_t next = 0; next < pending.size(); ++next) {
+            const auto [start, owner] = pending[next];
+
+            // Like those from remove_left_recursion,
+            // fresh nonterminals start with the empty production
+            factored = productions_t{};
+            if (trie[start].ends) factored.start_alternative();
+
+            for (auto child = trie[start].first_child; child != no_node;
+                 child = trie[child].next) {
+                // Follow the prefix until the alternatives part ways
+                auto node = child;
+                factored.start_alternative();
+                factored.append(trie[node].token);
+                while (not trie[node].ends and trie[node].child_count == 1) {
+                    node = trie[node].first_child;
+                    factored.append(trie[node].token);
+                }
+
+                if (trie[node].child_count != 0) {
+                    const auto fresh = output.new_nonterminal(
+                        output.fresh_nonterminal_symbol(nonterm));
+                    ++fresh_count;
+                    factored.append(fresh);
+                    pending.emplace_back(node, fresh);
+                }
+            }
+
+            budget.grow(owner, factored.size(), factored.token_count());
+            output.replace_alternatives(owner, std::move(factored));
+        }
     }
 
-    std::cout << "Result:\n";
-    std::cout << output << std::endl;
+    const auto after = grammar_size::of(output);
+    diag.info("Left factoring made ", fresh_count,
+              " new nonterminals and turned ", before.alternatives,
+              " alternatives of ", before.tokens, " tokens into ",
+              after.alternatives, " of ", after.tokens, '\n');
+
+    diag.verbose("Result:\n", output, '\n');
+    pass.finish(output);
     return output;
 }
 
-grammar remove_unit_productions(grammar input) {
-    while (input.has_any_cycle()) {
-        auto              output = grammar::copy_terminals_from(input);
-        const auto        input_nonterm_keys = input.nonterminal_keys();
-        const std::vector nonterms           = input.nonterminals();
-
-        for (const auto & nonterm : nonterms) {
-            auto rule_matrix = input.rule_matrix(nonterm);
-            auto new_rules   = decltype(rule_matrix){};
-
-            for (auto iter = rule_matrix.begin(); iter != rule_matrix.end();
-                 ++iter) {
-                auto dest_nonterm = iter->front();
-                if (iter->size() == 1
-                    and contains(nonterms.begin(), nonterms.end(),
-                                 dest_nonterm)) {
-                    if (iter == rule_matrix.begin()) {
-                        iter = rule_matrix.erase(iter);
-                    } else {
-                        auto last_iter = iter - 1;
-                        rule_matrix.erase(iter);
-                        iter = last_iter;
+grammar remove_epsilon(grammar input, pass_context & ctx) {
+    auto & diag = ctx.diag;
+    instrumentation::scope pass{ctx.stats, "remove_epsilon", input, ctx.pool};
+
+    if (not input.has_any_empty_production()) {
+        pass.finish(input);
+        return input;
+    }
+
+    // Each nonterminal's new alternatives only depend on its old ones,
+    // so they can be replaced one at a time
+    auto              output   = std::move(input);
+    const std::vector nonterms = output.nonterminals();
+    const auto        nullable = output.nullable();
+    resource_budget   budget{ctx.limits, "remove_epsilon", output};
+
+    // The nonterminals are independent, so they are spread over the workers.
+    // Each result has its own slot and they are stored in order afterwards,
+    // so the output does not depend on how the work was split.
+    std::deque<scratch_arena>  worker_scratch(ctx.workers());
+    std::vector<productions_t> final_rules(nonterms.size());
+
+    pass.iteration(nonterms.size());
+    ctx.parallel_for(nonterms.size(), [&](size_t index, size_t worker) {
+        const auto   nonterm     = nonterms[index];
+        const auto & input_rules = output.alternatives(nonterm);
+        auto * const arena       = worker_scratch[worker].resource();
+        auto &       final_rule  = final_rules[index];
+
+        // The budget holds the alternatives being made instead
+        budget.shrink(input_rules.size(), input_rules.token_count());
+
+        // The alternatives made so far, by their index in final_rule,
+        // so that the same one is never added twice
+        const auto hash = [&final_rule](size_t alternative) {
+            return rule_hash<token_t>{}(final_rule[alternative]);
+        };
+        const auto equal = [&final_rule](size_t lhs, size_t rhs) {
+            return final_rule[lhs] == final_rule[rhs];
+        };
+        std::pmr::unordered_set<size_t, decltype(hash), decltype(equal)> made{
+            input_rules.size(), hash, equal, arena};
+
+        // The distinct ways to write the end of the rule seen so far,
+        // each leaving out some of its nullable symbols, stored reversed.
+        // The rule is read right to left and duplicates are dropped at
+        // each step, so the work follows the number of distinct results
+        // even where most subsets give the same string, as with a run of
+        // the same nullable symbol. Reading from the right also keeps the
+        // order of leaving out each subset in turn, with the first
+        // nullable symbol changing fastest.
+        productions_t suffixes{};
+        productions_t extended{};
+        const auto    extended_hash = [&extended](size_t suffix) {
+            return rule_hash<token_t>{}(extended[suffix]);
+        };
+        const auto extended_equal = [&extended](size_t lhs, size_t rhs) {
+            return extended[lhs] == extended[rhs];
+        };
+        std::pmr::unordered_set<size_t, decltype(extended_hash),
+                                decltype(extended_equal)>
+            distinct{0, extended_hash, extended_equal, arena};
+
+        // The suffixes are charged to the budget while they are kept,
+        // so a rule with too many distinct variants stops the pass
+        // before they are all built
+        const auto replace_suffixes = [&] {
+            budget.grow(nonterm, extended.size(), extended.token_count());
+            budget.shrink(suffixes.size(), suffixes.token_count());
+            std::swap(suffixes, extended);
+        };
+
+        for (const auto rule : input_rules) {
+            suffixes.clear();
+            suffixes.start_alternative();
+            budget.grow(nonterm, 1, 0);
+
+            for (auto pos = rule.size(); pos-- > 0;) {
+                const auto token = rule[pos];
+                extended.clear();
+
+                if (token < 0 or not nullable.test(static_cast<int>(token))) {
+                    // Every suffix is still distinct with the same token
+                    for (const auto suffix : suffixes) {
+                        extended.add_alternative(suffix);
+                        extended.append(token);
                     }
-                    for (const auto & dest_rule :
-                         input.rule_matrix(dest_nonterm))
-                        new_rules.emplace_back(dest_rule);
+                    replace_suffixes();
+                    continue;
+                }
+
+                distinct.clear();
+                for (size_t index = 0; index < suffixes.size(); ++index) {
+                    // A step can take as long as all of the ones before it
+                    if (index % 256 == 255) budget.check(nonterm);
+
+                    const auto suffix = suffixes[index];
+                    extended.add_alternative(suffix);
+                    extended.append(token);
+                    if (not distinct.insert(extended.size() - 1).second)
+                        extended.pop_alternative();
+
+                    extended.add_alternative(suffix);
+                    if (not distinct.insert(extended.size() - 1).second)
+                        extended.pop_alternative();
                 }
+                replace_suffixes();
             }
+            budget.shrink(suffixes.size(), suffixes.token_count());
 
-            std::vector<token_t> final_rule{};
-            bool                 first = true;
-            for (const auto & rule : rule_matrix) {
-                if (rule.empty()) continue;
+            for (const auto suffix : suffixes) {
+                if (suffix.empty()) continue;
 
-                if (first)
-                    first = false;
+                final_rule.add_alternative(
+                    std::make_reverse_iterator(suffix.end()),
+                    std::make_reverse_iterator(suffix.begin()));
+                const auto added = final_rule.size() - 1;
+                if (not made.insert(added).second)
+                    final_rule.pop_alternative();
                 else
-                    final_rule.push_back(grammar::rule_sep);
+                    budget.grow(nonterm, 1, final_rule[added].size());
+            }
+        }
+    });
+
+    size_t input_count  = 0;
+    size_t output_count = 0;
+    for (size_t index = 0; index < nonterms.size(); ++index) {
+        input_count += output.alternatives(nonterms[index]).size();
+        output_count += final_rules[index].size();
+        output.replace_alternatives(nonterms[index],
+                                    std::move(final_rules[index]));
+    }
 
-                for (const auto & tok : rule) final_rule.push_back(tok);
+    diag.info("Removing the empty string turned ", input_count,
+              " alternatives into ", output_count, " (expansion factor ",
+              input_count == 0 ? 1.0
+                               : static_cast<double>(output_count)
+                                     / static_cast<double>(input_count),
+              ")\n");
+
+    // If the first symbol has epsilon, check if it is used anywhere
+    if (const auto initial = nonterms.front();
+        nullable.test(static_cast<int>(initial))
+        and output.in_some_production(initial)) {
+        // Since the initial symbol is used somewhere in the grammar
+        // and it can generate empty,
+        // the grammmar must be augmented.
+
+        // This is done in the form B -> A | empty ; A -> a_1 | a_2
+        // where the original rule was A -> empty | a_1 | a_2
+
+        // The new symbol added from the augmentation
+        const auto true_initial
+            = output.new_nonterminal(output.fresh_nonterminal_symbol(initial));
+        output.replace_alternatives(true_initial, productions_t{{initial}, {}});
+        budget.grow(true_initial, 2, 1);
+
+        diag.info("Grammar has been augmented\n");
+    }
+
+    diag.verbose("Result:\n", output, '\n');
+    pass.finish(output);
+    return output;
+}
+
+grammar remove_unit_productions(grammar input, pass_context & ctx) {
+    instrumentation::scope pass{ctx.stats, "remove_unit_productions", input,
+                                ctx.pool};
+
+    const std::vector nonterms = input.nonterminals();
+    resource_budget   budget{ctx.limits, "remove_unit_productions", input};
+
+    // The unit closure of A is every B such that A =>* B by unit productions.
+    // All members of a component share a closure, and the components are
+    // numbered so that successors come first. The closure of a component is
+    // then its members plus the closures of its successors.
+    // Components with one member and no successors are left empty,
+    // as their closure is just themselves.
+    const auto & [graph, components] = input.unit_productions();
+    std::vector<dynamic_bitset> closure(components.count());
+    for (size_t component = 0; component < components.count(); ++component) {
+        const auto first = components.members.begin()
+                           + components.member_starts[component];
+        const auto last = components.members.begin()
+                          + components.member_starts[component + 1];
+
+        if (last - first == 1
+            and graph.successors_begin(*first) == graph.successors_end(*first))
+            continue;
+
+        auto & reach = closure[component];
+        reach        = dynamic_bitset{graph.vertex_count()};
+        for (auto member = first; member != last; ++member) {
+            reach.set(*member);
+            for (auto iter = graph.successors_begin(*member);
+                 iter != graph.successors_end(*member); ++iter) {
+                const auto & successor_closure
+                    = closure[components.component_of[*iter]];
+                if (successor_closure.size() != 0)
+                    reach.merge(successor_closure);
+                else
+                    reach.set(*iter);
             }
+        }
+    }
 
-            for (const auto & rule : new_rules) {
-                if (not contains(rule_matrix.begin(), rule_matrix.end(), rule)
-                    and not(rule.size() == 1 and rule.front() == nonterm)) {
-                    // If the rule was not already added
-                    // and it is not a rule of the form "A -> A"
-                    // , add it
-                    final_rule.push_back(grammar::rule_sep);
-                    for (auto tok : rule) { final_rule.push_back(tok); }
+    const auto is_unit = [](const auto & rule) {
+        return rule.size() == 1 and rule.front() > 0;
+    };
+
+    // The new alternatives are built from the old ones of other nonterminals,
+    // so nothing is replaced until all of them have been built.
+    // Until then, the nonterminals are independent and can be spread over
+    // the workers, each filling in its own slots.
+    std::deque<scratch_arena>  worker_scratch(ctx.workers());
+    std::vector<productions_t> final_rules(nonterms.size());
+
+    pass.iteration(nonterms.size());
+    ctx.parallel_for(nonterms.size(), [&](size_t index, size_t worker) {
+        const auto nonterm    = nonterms[index];
+        auto &     final_rule = final_rules[index];
+
+        std::pmr::unordered_set<grammar::rule_t, rule_hash<token_t>>
+            seen_rules{worker_scratch[worker].resource()};
+
+        // Copies the rules of `source` that are not unit productions
+        // and have not been copied yet
+        const auto copy_rules_of = [&](token_t source) {
+            for (const auto rule : input.alternatives(source))
+                if (not is_unit(rule) and seen_rules.insert(rule).second) {
+                    final_rule.add_alternative(rule);
+                    budget.grow(nonterm, 1, rule.size());
                 }
-            }
+        };
 
-            output.add_rule(input_nonterm_keys.at(nonterm),
-                            std::move(final_rule));
-        }
+        // The budget holds the alternatives being made instead
+        const auto & own_rules = input.alternatives(nonterm);
+        budget.shrink(own_rules.size(), own_rules.token_count());
 
-        input = std::move(output);
-    }
+        // The nonterminal's own rules come first
+        copy_rules_of(nonterm);
+
+        const auto & reach
+            = closure[components.component_of[static_cast<int>(nonterm)]];
+        reach.for_each([&](size_t vertex) {
+            if (const auto target = token_t{static_cast<int>(vertex)};
+                target != nonterm)
+                copy_rules_of(target);
+        });
+    });
 
+    for (size_t index = 0; index < nonterms.size(); ++index)
+        input.replace_alternatives(nonterms[index],
+                                   std::move(final_rules[index]));
+
+    pass.finish(input);
     return input;
 }
 
-grammar remove_unreachables(const grammar & input) {
-    auto              output             = grammar::copy_terminals_from(input);
-    const auto        input_nonterm_keys = input.nonterminal_keys();
-    const std::vector nonterms           = input.nonterminals();
+grammar remove_unreachables(grammar input, pass_context & ctx) {
+    instrumentation::scope pass{ctx.stats, "remove_unreachables", input,
+                                ctx.pool};
+
+    const std::vector nonterms = input.nonterminals();
+    resource_budget   budget{ctx.limits, "remove_unreachables", input};
 
     // Save all reachable nonterminals
-    std::vector reachable{nonterms.front()};
-    for (size_t reachable_count = 0; reachable_count < reachable.size();
-         ++reachable_count) {
-        for (const auto & rule :
-             input.rule_matrix(reachable.at(reachable_count))) {
-            for (auto token : rule) {
-                // If a token is reachable, a nonterminal, and is not already
-                // reachable, add it to the list of reachables
-                if (contains(nonterms.begin(), nonterms.end(), token)
-                    and not contains(reachable.begin(), reachable.end(),
-                                     token)) {
-                    reachable.push_back(token);
-                }
-            }
-        }
+    dynamic_bitset reachable{static_cast<size_t>(
+        static_cast<int>(input.next_nonterminal()))};
+    for (auto nonterm : input.reachable_from(nonterms.front()))
+        reachable.set(static_cast<int>(nonterm));
+
+    // Nothing reachable uses an unreachable nonterminal,
+    // so they can be erased on their own
+    for (auto nonterm : nonterms) {
+        pass.iteration();
+        budget.check(nonterm);
+        if (not reachable.test(static_cast<int>(nonterm)))
+            input.erase_nonterminal(nonterm);
     }
 
-    for (auto nonterm : reachable) {
-        std::vector<token_t> final_rule{};
-        bool                 first = true;
-        for (const auto & rule : input.rule_matrix(nonterm)) {
-            if (first)
-                first = false;
-            else
-                final_rule.push_back(grammar::rule_sep);
+    pass.finish(input);
+    return input;
+}
 
-            for (const auto & tok : rule) final_rule.push_back(tok);
-        }
-        output.add_rule(input_nonterm_keys.at(nonterm), std::move(final_rule));
+grammar remove_useless(grammar input, pass_context & ctx) {
+    instrumentation::scope pass{ctx.stats, "remove_useless", input, ctx.pool};
+
+    const std::vector nonterms = input.nonterminals();
+    resource_budget   budget{ctx.limits, "remove_useless", input};
+
+    // A rule is useless if it mentions a nonterminal that cannot produce a
+    // string of terminals. Once those rules are ignored, a nonterminal is
+    // useless if the initial symbol cannot reach it.
+    // The initial symbol itself is always kept, even if it is unproductive.
+    // Copied, as editing the grammar clears its cached analyses.
+    const auto productive = input.productive();
+    const auto is_useful  = [&productive](const auto & rule) {
+        return std::all_of(rule.begin(), rule.end(), [&productive](auto token) {
+            return token < 0 or productive.test(static_cast<int>(token));
+        });
+    };
+
+    dynamic_bitset reachable{productive.size()};
+    for (auto nonterm : input.reachable_from(nonterms.front(), true))
+        reachable.set(static_cast<int>(nonterm));
+
+    // Filtering is independent for each nonterminal, so it is spread over
+    // the workers. Only the nonterminals losing an alternative get a slot.
+    std::vector<std::optional<productions_t>> final_rules(nonterms.size());
+
+    pass.iteration(nonterms.size());
+    ctx.parallel_for(nonterms.size(), [&](size_t index, size_t) {
+        const auto nonterm = nonterms[index];
+        budget.check(nonterm);
+        if (not reachable.test(static_cast<int>(nonterm))) return;
+
+        const auto & rules = input.alternatives(nonterm);
+        if (std::all_of(rules.begin(), rules.end(), is_useful)) return;
+
+        auto & final_rule = final_rules[index].emplace();
+        for (const auto rule : rules)
+            if (is_useful(rule)) final_rule.add_alternative(rule);
+    });
+
+    for (size_t index = 0; index < nonterms.size(); ++index) {
+        const auto nonterm = nonterms[index];
+        if (not reachable.test(static_cast<int>(nonterm)))
+            input.erase_nonterminal(nonterm);
+        else if (final_rules[index])
+            input.replace_alternatives(nonterm, std::move(*final_rules[index]));
     }
 
-    return output;
+    pass.finish(input);
+    return input;
 }
@@ -4,13 +4,59 @@
 #include <optional>
 
 #include "grammar.hpp"
+#include "left_recursion_cache.hpp"
+#include "pass_context.hpp"
 
-std::optional<grammar> remove_left_recursion(const grammar & input);
+// Every transform reports its progress to `ctx.diag`
+// and, if `ctx.stats` is set, records what it cost there.
+// The grammars are taken by value and edited in place,
+// so callers which no longer need the input should move it in.
+// A transform which goes over `ctx.limits` stops where it is
+// and throws resource_exhausted.
 
-grammar make_proper_form(const grammar & input);
+std::optional<grammar> remove_left_recursion(
+    grammar input, pass_context & ctx = pass_context::standard());
 
-grammar remove_epsilon(const grammar & input);
-grammar remove_unit_productions(grammar  input);
-grammar remove_unreachables(const grammar & input);
+// Like the above, but only rewrites the nonterminals whose alternatives,
+// or the results of the nonterminals substituted into them, differ from
+// those in the cache. The others take their cached results.
+// The output is the same as from a full run, and the cache is refilled
+// with this run's results.
+std::optional<grammar> remove_left_recursion(
+    grammar input, left_recursion_cache & cache,
+    pass_context & ctx = pass_context::standard());
+
+// Like the first remove_left_recursion, but only substitutes between
+// nonterminals in the same cycle of left corners (A -> B g), as no other
+// substitution can remove left recursion. The work and the growth of the
+// grammar then depend on the left recursive parts alone.
+// Substitution is repeated until no alternative starts with an earlier
+// nonterminal of its cycle, so indirect recursion through several
+// substitutions is removed as well.
+std::optional<grammar> remove_left_recursion_by_components(
+    grammar input, pass_context & ctx = pass_context::standard());
+
+grammar make_proper_form(grammar        input,
+                         pass_context & ctx = pass_context::standard());
+
+// Gives the alternatives of each nonterminal which share a prefix
+// one alternative instead: the prefix followed by a fresh nonterminal,
+// whose alternatives are what came after it, which may be nothing.
+// Shared prefixes are found with a trie of each nonterminal's alternatives,
+// so the pass runs in time linear in the size of the grammar.
+// Duplicate alternatives are dropped on the way.
+grammar left_factor(grammar        input,
+                    pass_context & ctx = pass_context::standard());
+
+grammar remove_epsilon(grammar        input,
+                       pass_context & ctx = pass_context::standard());
+grammar remove_unit_productions(grammar        input,
+                                pass_context & ctx = pass_context::standard());
+grammar remove_unreachables(grammar        input,
+                            pass_context & ctx = pass_context::standard());
+
+// Removes unproductive and unreachable nonterminals in one linear pass
+grammar remove_useless(grammar        input,
+                       pass_context & ctx = pass_context::standard());
 
 #endif
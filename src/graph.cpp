@@ -0,0 +1,143 @@
+#include "graph.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using vertex_t = digraph::vertex_t;
+
+digraph::digraph(size_t vertex_count,
+                 const std::vector<std::pair<vertex_t, vertex_t>> & edges)
+    : starts(vertex_count + 1, 0)
+    , targets(edges.size()) {
+    // Counting sort of the edges by their source
+    for (const auto & edge : edges) starts[edge.first + 1]++;
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex)
+        starts[vertex + 1] += starts[vertex];
+
+    auto next_slot = starts;
+    for (const auto & edge : edges)
+        targets[next_slot[edge.first]++] = edge.second;
+}
+
+bool digraph::has_edge(vertex_t from, vertex_t to) const {
+    return std::find(successors_begin(from), successors_end(from), to)
+           != successors_end(from);
+}
+
+strong_components find_strong_components(const digraph & graph) {
+    static constexpr auto unvisited
+        = std::numeric_limits<std::uint32_t>::max();
+
+    const auto vertex_count = graph.vertex_count();
+
+    strong_components to_ret{};
+    to_ret.component_of.assign(vertex_count, unvisited);
+    to_ret.members.reserve(vertex_count);
+
+    std::vector<std::uint32_t> index(vertex_count, unvisited);
+    std::vector<std::uint32_t> low_link(vertex_count, 0);
+    std::vector<bool>          on_stack(vertex_count, false);
+    std::vector<vertex_t>      stack{};
+    std::uint32_t              next_index = 0;
+
+    // Each frame is a vertex and how far through its successors we are
+    std::vector<std::pair<vertex_t, const vertex_t *>> call_stack{};
+
+    const auto visit = [&](vertex_t vertex) {
+        index[vertex] = low_link[vertex] = next_index++;
+        stack.push_back(vertex);
+        on_stack[vertex] = true;
+        call_stack.emplace_back(vertex, graph.successors_begin(vertex));
+    };
+
+    for (vertex_t root = 0; root < vertex_count; ++root) {
+        if (index[root] != unvisited) continue;
+
+        visit(root);
+        while (not call_stack.empty()) {
+            auto & [vertex, next_successor] = call_stack.back();
+
+            if (next_successor != graph.successors_end(vertex)) {
+                const auto successor = *next_successor++;
+                if (index[successor] == unvisited)
+                    visit(successor);
+                else if (on_stack[successor])
+                    low_link[vertex]
+                        = std::min(low_link[vertex], index[successor]);
+                continue;
+            }
+
+            // All successors are done
+            const auto finished = vertex;
+            call_stack.pop_back();
+
+            if (not call_stack.empty()) {
+                const auto parent = call_stack.back().first;
+                low_link[parent]
+                    = std::min(low_link[parent], low_link[finished]);
+            }
+
+            if (low_link[finished] != index[finished]) continue;
+
+            // `finished` is the root of a component
+            const auto component = static_cast<std::uint32_t>(to_ret.count());
+            vertex_t   member    = 0;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                on_stack[member]            = false;
+                to_ret.component_of[member] = component;
+                to_ret.members.push_back(member);
+            } while (member != finished);
+
+            const auto size
+                = to_ret.members.size() - to_ret.member_starts.back();
+            to_ret.member_starts.push_back(
+                static_cast<std::uint32_t>(to_ret.members.size()));
+            to_ret.cyclic.push_back(size > 1
+                                    or graph.has_edge(finished, finished));
+        }
+    }
+
+    return to_ret;
+}
+
+std::vector<vertex_t> find_cycle_through(const digraph &           graph,
+                                         const strong_components & components,
+                                         vertex_t                  start) {
+    const auto component = components.component_of.at(start);
+    if (not components.cyclic.at(component)) return {};
+
+    if (graph.has_edge(start, start)) return {start, start};
+
+    // Breadth first search inside the component, back to the start
+    static constexpr auto no_parent = std::numeric_limits<vertex_t>::max();
+    std::vector<vertex_t> parent(graph.vertex_count(), no_parent);
+    std::vector<vertex_t> queue{start};
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const auto vertex = queue[head];
+        for (auto iter = graph.successors_begin(vertex);
+             iter != graph.successors_end(vertex); ++iter) {
+            const auto successor = *iter;
+            if (components.component_of[successor] != component) continue;
+
+            if (successor == start) {
+                // Walk the parents back to the start
+                std::vector<vertex_t> to_ret{start};
+                for (auto step = vertex; step != start; step = parent[step])
+                    to_ret.push_back(step);
+                to_ret.push_back(start);
+                std::reverse(to_ret.begin(), to_ret.end());
+                return to_ret;
+            }
+
+            if (parent[successor] == no_parent) {
+                parent[successor] = vertex;
+                queue.push_back(successor);
+            }
+        }
+    }
+
+    return {};
+}
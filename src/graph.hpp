@@ -0,0 +1,73 @@
+#ifndef GRAPH_HPP
+#define GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A directed graph over the vertices [0, vertex_count).
+// The edges are stored as one adjacency array,
+// with the successors of each vertex next to each other.
+class digraph final {
+   public:
+    using vertex_t = std::uint32_t;
+
+    digraph() = default;
+    digraph(size_t vertex_count,
+            const std::vector<std::pair<vertex_t, vertex_t>> & edges);
+
+    [[nodiscard]] size_t vertex_count() const { return starts.size() - 1; }
+    [[nodiscard]] size_t edge_count() const { return targets.size(); }
+
+    [[nodiscard]] const vertex_t * successors_begin(vertex_t vertex) const {
+        return targets.data() + starts[vertex];
+    }
+    [[nodiscard]] const vertex_t * successors_end(vertex_t vertex) const {
+        return targets.data() + starts[vertex + 1];
+    }
+
+    [[nodiscard]] bool has_edge(vertex_t from, vertex_t to) const;
+
+   private:
+    std::vector<std::uint32_t> starts{0};
+    std::vector<vertex_t>      targets{};
+};
+
+// The strongly connected components of a digraph.
+// Components are numbered in reverse topological order:
+// every edge goes from a component to one with a smaller or equal number.
+struct strong_components final {
+    using vertex_t = digraph::vertex_t;
+
+    // The component number of each vertex
+    std::vector<std::uint32_t> component_of{};
+    // The vertices of component i are
+    // members[member_starts[i], member_starts[i + 1])
+    std::vector<vertex_t>      members{};
+    std::vector<std::uint32_t> member_starts{0};
+    // Whether the component contains a cycle,
+    // i.e. has more than one vertex or a self loop
+    std::vector<bool> cyclic{};
+
+    [[nodiscard]] size_t count() const { return member_starts.size() - 1; }
+
+    [[nodiscard]] bool any_cyclic() const {
+        for (const auto is_cyclic : cyclic)
+            if (is_cyclic) return true;
+        return false;
+    }
+};
+
+// Tarjan's algorithm, written iteratively so deep graphs cannot overflow the
+// stack. Runs in O(V + E).
+[[nodiscard]] strong_components find_strong_components(const digraph & graph);
+
+// Returns a shortest cycle through `start` that stays inside its component,
+// as a list of vertices beginning and ending with `start`.
+// Empty if `start` is not on a cycle. Runs in O(V + E).
+[[nodiscard]] std::vector<digraph::vertex_t> find_cycle_through(
+    const digraph & graph, const strong_components & components,
+    digraph::vertex_t start);
+
+#endif
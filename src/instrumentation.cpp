@@ -0,0 +1,101 @@
+#include "instrumentation.hpp"
+
+#include <ostream>
+
+#include "grammar.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+    thread_local size_t allocation_count = 0;
+    thread_local size_t allocated_bytes  = 0;
+
+    void write_size(std::ostream & out, const grammar_size & size) {
+        out << "{\"nonterminals\": " << size.nonterminals
+            << ", \"alternatives\": " << size.alternatives
+            << ", \"tokens\": " << size.tokens << '}';
+    }
+
+    // The allocations of the calling thread and the pool's workers so far
+    size_t allocations_so_far(const thread_pool * pool) {
+        return thread_allocation_count()
+             + (pool != nullptr ? pool->worker_allocation_count() : 0);
+    }
+
+    size_t bytes_so_far(const thread_pool * pool) {
+        return thread_allocated_bytes()
+             + (pool != nullptr ? pool->worker_allocated_bytes() : 0);
+    }
+}  // namespace
+
+void count_allocation(size_t size) noexcept {
+    ++allocation_count;
+    allocated_bytes += size;
+}
+
+size_t thread_allocation_count() { return allocation_count; }
+
+size_t thread_allocated_bytes() { return allocated_bytes; }
+
+grammar_size grammar_size::of(const grammar & input) {
+    grammar_size to_ret{};
+    for (const auto nonterm : input.nonterminals()) {
+        const auto & rules = input.alternatives(nonterm);
+        to_ret.nonterminals++;
+        to_ret.alternatives += rules.size();
+        to_ret.tokens += rules.token_count();
+    }
+    return to_ret;
+}
+
+instrumentation::scope::scope(instrumentation * owner, const char * name,
+                              const grammar & input, const thread_pool * pool)
+    : owner{owner}
+    , pool{pool} {
+    if (owner == nullptr) return;
+
+    record.name       = name;
+    record.input      = grammar_size::of(input);
+    start_allocations = allocations_so_far(pool);
+    start_bytes       = bytes_so_far(pool);
+    start             = std::chrono::steady_clock::now();
+}
+
+instrumentation::scope::~scope() {
+    if (owner != nullptr) owner->records.push_back(std::move(record));
+}
+
+void instrumentation::scope::complete(const grammar & output) {
+    const auto end = std::chrono::steady_clock::now();
+
+    record.completed = true;
+    record.wall_ms
+        = std::chrono::duration<double, std::milli>(end - start).count();
+    record.allocations     = allocations_so_far(pool) - start_allocations;
+    record.allocated_bytes = bytes_so_far(pool) - start_bytes;
+    record.output          = grammar_size::of(output);
+}
+
+void instrumentation::write_json(std::ostream & out) const {
+    out << "{\n  \"passes\": [";
+
+    bool first = true;
+    for (const auto & record : records) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+
+        // Pass names are plain identifiers, so they need no escaping
+        out << "    {\"name\": \"" << record.name << "\", \"completed\": "
+            << (record.completed ? "true" : "false")
+            << ", \"wall_ms\": " << record.wall_ms
+            << ", \"iterations\": " << record.iterations
+            << ", \"allocations\": " << record.allocations
+            << ", \"allocated_bytes\": " << record.allocated_bytes
+            << ", \"input\": ";
+        write_size(out, record.input);
+        out << ", \"output\": ";
+        write_size(out, record.output);
+        out << '}';
+    }
+
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,96 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class grammar;
+class thread_pool;
+
+// How big a grammar is
+struct grammar_size {
+    size_t nonterminals = 0;
+    size_t alternatives = 0;
+    size_t tokens       = 0;
+
+    [[nodiscard]] static grammar_size of(const grammar & input);
+};
+
+// What one run of a transform cost
+struct pass_record {
+    std::string  name{};
+    bool         completed = false;
+    double       wall_ms   = 0;
+    grammar_size input{};
+    grammar_size output{};
+    // Heap allocations made while the pass ran, on its thread
+    // and on the workers of the thread_pool it was given
+    size_t allocations     = 0;
+    size_t allocated_bytes = 0;
+    // How many times the pass went around its main loop,
+    // usually once for each nonterminal it processed
+    size_t iterations = 0;
+};
+
+// The number of heap allocations made by this thread so far.
+// Counted by the replacement operator new in allocation_counter.cpp,
+// which is not part of the library: a program which wants the counts
+// adds that file to its sources, and without it they stay zero.
+[[nodiscard]] size_t thread_allocation_count();
+[[nodiscard]] size_t thread_allocated_bytes();
+
+// Adds an allocation of `size` bytes to this thread's counts
+void count_allocation(size_t size) noexcept;
+
+// Collects a pass_record for every transform that runs
+class instrumentation final {
+   public:
+    // Measures one pass from construction until finish() or destruction.
+    // Passes which never call finish() are recorded as not completed.
+    // With no instrumentation to report to, every member does nothing.
+    class scope final {
+       public:
+        // Allocations made by the workers of `pool`, if there is one,
+        // are counted too
+        scope(instrumentation * owner, const char * name,
+              const grammar & input, const thread_pool * pool = nullptr);
+        ~scope();
+
+        scope(const scope &) = delete;
+        scope & operator=(const scope &) = delete;
+
+        void iteration(size_t count = 1) {
+            if (owner != nullptr) record.iterations += count;
+        }
+
+        // Records the output of the pass
+        void finish(const grammar & output) {
+            if (owner != nullptr) complete(output);
+        }
+
+       private:
+        void complete(const grammar & output);
+
+        instrumentation *                     owner;
+        const thread_pool *                   pool;
+        pass_record                           record{};
+        std::chrono::steady_clock::time_point start{};
+        size_t                                start_allocations = 0;
+        size_t                                start_bytes       = 0;
+    };
+
+    [[nodiscard]] const std::vector<pass_record> & passes() const {
+        return records;
+    }
+
+    // Writes every record as one JSON object
+    void write_json(std::ostream & out) const;
+
+   private:
+    std::vector<pass_record> records{};
+};
+
+#endif
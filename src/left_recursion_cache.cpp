@@ -0,0 +1,151 @@
+#include "left_recursion_cache.hpp"
+
+#include <ostream>
+
+namespace {
+    using rules_t = left_recursion_cache::rules_t;
+
+    constexpr size_t field_size = 4;
+
+    void put(std::string & buffer, std::uint32_t value) {
+        for (unsigned byte = 0; byte < field_size; ++byte)
+            buffer += static_cast<char>((value >> (8 * byte)) & 0xffu);
+    }
+
+    void put(std::string & buffer, const rules_t & rules) {
+        put(buffer, static_cast<std::uint32_t>(rules.size()));
+        for (const auto rule : rules) {
+            put(buffer, static_cast<std::uint32_t>(rule.size()));
+            for (const auto index : rule) put(buffer, index);
+        }
+    }
+
+    // Reads the fields written by put, in order.
+    // After the first read past the end of the data, every read fails.
+    class reader final {
+       public:
+        explicit reader(std::string_view data)
+            : data{data} {}
+
+        [[nodiscard]] bool good() const { return not failed; }
+
+        [[nodiscard]] std::uint32_t field() {
+            if (failed or data.size() - position < field_size) {
+                failed = true;
+                return 0;
+            }
+
+            std::uint32_t to_ret = 0;
+            for (unsigned byte = 0; byte < field_size; ++byte)
+                to_ret |= static_cast<std::uint32_t>(
+                              static_cast<unsigned char>(data[position + byte]))
+                          << (8 * byte);
+            position += field_size;
+            return to_ret;
+        }
+
+        [[nodiscard]] std::string_view bytes(size_t length) {
+            if (failed or data.size() - position < length) {
+                failed = true;
+                return std::string_view{};
+            }
+
+            const auto to_ret = data.substr(position, length);
+            position += length;
+            return to_ret;
+        }
+
+        // Every index must be below `symbol_count`
+        [[nodiscard]] rules_t rules(size_t symbol_count) {
+            rules_t to_ret{};
+            for (auto remaining = field(); remaining != 0 and not failed;
+                 --remaining) {
+                to_ret.start_alternative();
+                for (auto length = field(); length != 0 and not failed;
+                     --length) {
+                    const auto index = field();
+                    if (index >= symbol_count) failed = true;
+                    to_ret.append(index);
+                }
+            }
+            return to_ret;
+        }
+
+        [[nodiscard]] bool at_end() const { return position == data.size(); }
+
+       private:
+        std::string_view data;
+        size_t           position = 0;
+        bool             failed   = false;
+    };
+}  // namespace
+
+std::optional<left_recursion_cache> left_recursion_cache::load(
+    std::string_view data) {
+    reader read{data};
+    if (read.field() != magic or read.field() != version)
+        return std::optional<left_recursion_cache>{};
+
+    const size_t symbol_count = read.field();
+    const size_t entry_count  = read.field();
+
+    left_recursion_cache to_ret{};
+    for (size_t index = 0; index < symbol_count and read.good(); ++index)
+        to_ret.symbol_list.emplace_back(read.bytes(read.field()));
+
+    const auto valid = [symbol_count](index_t index) {
+        return index < symbol_count;
+    };
+
+    for (size_t index = 0; index < entry_count and read.good(); ++index) {
+        entry current{};
+        current.nonterminal = read.field();
+        current.fresh       = read.field();
+        if (not valid(current.nonterminal)
+            or (current.fresh != no_symbol and not valid(current.fresh)))
+            return std::optional<left_recursion_cache>{};
+
+        for (auto remaining = read.field(); remaining != 0 and read.good();
+             --remaining) {
+            const auto dependency = read.field();
+            if (not valid(dependency))
+                return std::optional<left_recursion_cache>{};
+            current.dependencies.push_back(dependency);
+        }
+
+        current.input        = read.rules(symbol_count);
+        current.output       = read.rules(symbol_count);
+        current.fresh_output = read.rules(symbol_count);
+        to_ret.entry_list.push_back(std::move(current));
+    }
+
+    if (not read.good() or not read.at_end())
+        return std::optional<left_recursion_cache>{};
+    return to_ret;
+}
+
+void left_recursion_cache::save(std::ostream & out) const {
+    std::string buffer{};
+    put(buffer, magic);
+    put(buffer, version);
+    put(buffer, static_cast<std::uint32_t>(symbol_list.size()));
+    put(buffer, static_cast<std::uint32_t>(entry_list.size()));
+
+    for (const auto & symbol : symbol_list) {
+        put(buffer, static_cast<std::uint32_t>(symbol.size()));
+        buffer += symbol;
+    }
+
+    for (const auto & current : entry_list) {
+        put(buffer, current.nonterminal);
+        put(buffer, current.fresh);
+        put(buffer, static_cast<std::uint32_t>(current.dependencies.size()));
+        for (const auto dependency : current.dependencies)
+            put(buffer, dependency);
+        put(buffer, current.input);
+        put(buffer, current.output);
+        put(buffer, current.fresh_output);
+    }
+
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
@@ -0,0 +1,83 @@
+#ifndef LEFT_RECURSION_CACHE_HPP
+#define LEFT_RECURSION_CACHE_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "production_list.hpp"
+
+// The results of one run of remove_left_recursion, kept for the next run.
+// The tokens of an edited grammar are not the same as before,
+// so the cache has its own list of symbols and refers to them by index.
+// Each symbol then only has to be looked up once per run.
+//
+// It is saved as little-endian 32 bit fields:
+//   magic, version, symbol count, entry count,
+//   each symbol as its length and then its bytes,
+//   each entry as its nonterminal, its fresh nonterminal,
+//   its dependencies as a count and the indices,
+//   and then its input, output, and fresh output alternatives,
+//   each as a count of alternatives, with every alternative
+//   as its length and then the indices.
+class left_recursion_cache final {
+   public:
+    using index_t = std::uint32_t;
+    using rules_t = production_list<index_t>;
+
+    static constexpr index_t no_symbol = UINT32_MAX;
+
+    // "CLRC"
+    static constexpr std::uint32_t magic = 0x43524c43u;
+    // Caches with any other version are ignored
+    static constexpr std::uint32_t version = 1;
+
+    // What happened to one nonterminal.
+    // The result can be reused when both the input and the dependencies
+    // are the same and none of the dependencies has a new result.
+    struct entry {
+        index_t nonterminal = no_symbol;
+        rules_t input{};
+        // The nonterminals substituted into the front of the alternatives,
+        // which are those earlier in the order of the pass
+        std::vector<index_t> dependencies{};
+        rules_t              output{};
+        // The nonterminal made to remove immediate left recursion,
+        // no_symbol if there was none
+        index_t fresh = no_symbol;
+        rules_t fresh_output{};
+    };
+
+    // Reads a cache written by save, such as a mapped file.
+    // Returns nothing if the data is not a cache of this version.
+    [[nodiscard]] static std::optional<left_recursion_cache> load(
+        std::string_view data);
+
+    void save(std::ostream & out) const;
+
+    // Indexed by the entries. Unused indices hold an empty string.
+    [[nodiscard]] const std::vector<std::string> & symbols() const {
+        return symbol_list;
+    }
+
+    [[nodiscard]] const std::vector<entry> & entries() const {
+        return entry_list;
+    }
+
+    // Replaces everything, so nonterminals which are gone are forgotten
+    void replace(std::vector<std::string> && new_symbols,
+                 std::vector<entry> &&       new_entries) {
+        symbol_list = std::move(new_symbols);
+        entry_list  = std::move(new_entries);
+    }
+
+   private:
+    std::vector<std::string> symbol_list{};
+    std::vector<entry>       entry_list{};
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "ll1.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "graph.hpp"
+
+using token_t = grammar::token_t;
+
+namespace {
+    using edge_list = std::vector<std::pair<digraph::vertex_t,
+                                            digraph::vertex_t>>;
+
+    // Adds every set to the sets of its successors in `graph`,
+    // until no set changes. Only a set which grew is spread again.
+    void propagate(const digraph & graph, std::vector<dynamic_bitset> & sets,
+                   const std::vector<token_t> & nonterms) {
+        std::vector<digraph::vertex_t> worklist{};
+        std::vector<bool>              queued(sets.size(), false);
+        for (const auto nonterm : nonterms) {
+            worklist.push_back(static_cast<int>(nonterm));
+            queued[static_cast<int>(nonterm)] = true;
+        }
+
+        while (not worklist.empty()) {
+            const auto vertex = worklist.back();
+            worklist.pop_back();
+            queued[vertex] = false;
+
+            for (auto iter = graph.successors_begin(vertex);
+                 iter != graph.successors_end(vertex); ++iter)
+                if (sets[*iter].merge(sets[vertex]) and not queued[*iter]) {
+                    queued[*iter] = true;
+                    worklist.push_back(*iter);
+                }
+        }
+    }
+}  // namespace
+
+ll1_sets::ll1_sets(const grammar & input)
+    : terminal_count{ll1_sets::terminal_index(input.next_terminal())}
+    , nullable_set{input.nullable()} {
+    const std::vector nonterms = input.nonterminals();
+    const auto        vertex_count
+        = static_cast<size_t>(static_cast<int>(input.next_nonterminal()));
+
+    first_sets.assign(vertex_count, dynamic_bitset{terminal_count + 1});
+    follow_sets.assign(vertex_count, dynamic_bitset{terminal_count + 1});
+
+    // FIRST(A) has the terminals starting its alternatives
+    // once the nullable nonterminals before them are left out,
+    // and includes FIRST(B) for each nonterminal B reached that way.
+    // The edge B -> A says so.
+    edge_list edges{};
+    for (const auto nonterm : nonterms) {
+        auto & first = first_sets[static_cast<int>(nonterm)];
+        for (const auto rule : input.alternatives(nonterm))
+            for (const auto token : rule) {
+                if (token < 0) {
+                    first.set(terminal_index(token));
+                    break;
+                }
+
+                if (token != nonterm)
+                    edges.emplace_back(static_cast<int>(token),
+                                       static_cast<int>(nonterm));
+                if (not nullable(token)) break;
+            }
+    }
+    propagate(digraph{vertex_count, edges}, first_sets, nonterms);
+
+    // For A -> a B b, FOLLOW(B) has FIRST(b), and includes FOLLOW(A)
+    // if b is nullable. The edge A -> B says so.
+    // Going right to left, `trailer` is FIRST(b) for the b after each B.
+    edges.clear();
+    follow_sets[static_cast<int>(nonterms.front())].set(end_of_input());
+
+    dynamic_bitset trailer{terminal_count + 1};
+    for (const auto nonterm : nonterms)
+        for (const auto rule : input.alternatives(nonterm)) {
+            trailer.clear();
+            bool trailer_nullable = true;
+
+            for (auto pos = rule.size(); pos-- > 0;) {
+                const auto token = rule[pos];
+                if (token < 0) {
+                    trailer.clear();
+                    trailer.set(terminal_index(token));
+                    trailer_nullable = false;
+                    continue;
+                }
+
+                follow_sets[static_cast<int>(token)].merge(trailer);
+                if (trailer_nullable and token != nonterm)
+                    edges.emplace_back(static_cast<int>(nonterm),
+                                       static_cast<int>(token));
+
+                if (nullable(token)) {
+                    trailer.merge(first(token));
+                } else {
+                    trailer          = first(token);
+                    trailer_nullable = false;
+                }
+            }
+        }
+    propagate(digraph{vertex_count, edges}, follow_sets, nonterms);
+}
+
+bool ll1_sets::first_of(grammar::rule_t rule, dynamic_bitset & to_ret) const {
+    to_ret.clear();
+    for (const auto token : rule) {
+        if (token < 0) {
+            to_ret.set(terminal_index(token));
+            return false;
+        }
+
+        to_ret.merge(first(token));
+        if (not nullable(token)) return false;
+    }
+    return true;
+}
+
+ll1_table::ll1_table(const grammar & input, const ll1_sets & sets)
+    : starts(static_cast<size_t>(static_cast<int>(input.next_nonterminal()))
+                 + 1,
+             0) {
+    // Which alternative each terminal predicts so far,
+    // for the nonterminal being filled in
+    std::vector<index_t> owner(sets.end_of_input() + 1, no_alternative);
+    std::vector<index_t> used{};
+    dynamic_bitset       predicted{sets.end_of_input() + 1};
+
+    size_t next_start = 0;
+    for (const auto nonterm : input.nonterminals()) {
+        const auto row = static_cast<size_t>(static_cast<int>(nonterm));
+        for (; next_start <= row; ++next_start)
+            starts[next_start] = static_cast<index_t>(entries.size());
+
+        const auto & rules = input.alternatives(nonterm);
+        for (index_t alt = 0; alt < rules.size(); ++alt) {
+            if (sets.first_of(rules[alt], predicted))
+                predicted.merge(sets.follow(nonterm));
+
+            predicted.for_each([&](size_t terminal) {
+                auto & current = owner[terminal];
+                if (current == no_alternative) {
+                    current = alt;
+                    used.push_back(static_cast<index_t>(terminal));
+                } else {
+                    conflict_list.push_back({nonterm, terminal, current, alt});
+                }
+            });
+        }
+
+        std::sort(used.begin(), used.end());
+        for (const auto terminal : used) {
+            entries.push_back({terminal, owner[terminal]});
+            owner[terminal] = no_alternative;
+        }
+        used.clear();
+    }
+
+    for (; next_start < starts.size(); ++next_start)
+        starts[next_start] = static_cast<index_t>(entries.size());
+}
+
+ll1_table::index_t ll1_table::predict(token_t nonterminal,
+                                      size_t  terminal) const {
+    const auto row = static_cast<size_t>(static_cast<int>(nonterminal));
+    if (row + 1 >= starts.size()) return no_alternative;
+
+    const auto first = entries.begin() + starts[row];
+    const auto last  = entries.begin() + starts[row + 1];
+    const auto found = std::lower_bound(
+        first, last, terminal,
+        [](const entry & lhs, size_t rhs) { return lhs.terminal < rhs; });
+    return found != last and found->terminal == terminal ? found->alternative
+                                                         : no_alternative;
+}
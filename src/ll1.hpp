@@ -0,0 +1,109 @@
+#ifndef LL1_HPP
+#define LL1_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bitset.hpp"
+#include "grammar.hpp"
+
+// The nullable, FIRST, and FOLLOW sets of every nonterminal of a grammar.
+// The initial symbol is the nonterminal with the smallest token.
+//
+// Sets of terminals are bitsets indexed by terminal_index,
+// with one more index, end_of_input, for the end of the input.
+// Each set is spread to the sets including it from a worklist,
+// so every nonterminal is only revisited when a set it includes grew.
+class ll1_sets final {
+   public:
+    explicit ll1_sets(const grammar & input);
+
+    // The index of a terminal in the sets
+    [[nodiscard]] static size_t terminal_index(grammar::token_t terminal) {
+        return static_cast<size_t>(-static_cast<int>(terminal) - 1);
+    }
+
+    // The terminal at an index below end_of_input()
+    [[nodiscard]] static grammar::token_t terminal_at(size_t index) {
+        return grammar::token_t{-static_cast<int>(index) - 1};
+    }
+
+    [[nodiscard]] size_t end_of_input() const { return terminal_count; }
+
+    [[nodiscard]] bool nullable(grammar::token_t nonterminal) const {
+        return nullable_set.test(static_cast<int>(nonterminal));
+    }
+
+    [[nodiscard]] const dynamic_bitset & first(
+        grammar::token_t nonterminal) const {
+        return first_sets[static_cast<int>(nonterminal)];
+    }
+
+    [[nodiscard]] const dynamic_bitset & follow(
+        grammar::token_t nonterminal) const {
+        return follow_sets[static_cast<int>(nonterminal)];
+    }
+
+    // Sets `to_ret` to the terminals which can start `rule`,
+    // and returns whether `rule` can derive the empty string.
+    // `to_ret` must have end_of_input() + 1 bits.
+    bool first_of(grammar::rule_t rule, dynamic_bitset & to_ret) const;
+
+   private:
+    size_t                      terminal_count;
+    dynamic_bitset              nullable_set;
+    std::vector<dynamic_bitset> first_sets;
+    std::vector<dynamic_bitset> follow_sets;
+};
+
+// The LL(1) parse table of a grammar: which alternative of a nonterminal
+// to expand when the next input is a given terminal.
+// An alternative is predicted by FIRST of the alternative,
+// and by FOLLOW of the nonterminal if the alternative is nullable.
+//
+// Only the entries which are there are stored, sorted by terminal,
+// so the table stays small for grammars with thousands of terminals.
+class ll1_table final {
+   public:
+    using index_t = std::uint32_t;
+
+    static constexpr index_t no_alternative = UINT32_MAX;
+
+    // Two alternatives predicted by the same terminal.
+    // Only the first alternative predicted is kept in the table.
+    struct conflict {
+        grammar::token_t nonterminal;
+        // An index from ll1_sets
+        size_t  terminal;
+        index_t kept;
+        index_t other;
+    };
+
+    ll1_table(const grammar & input, const ll1_sets & sets);
+
+    // The alternative of `nonterminal` to expand on the terminal at
+    // `terminal`, or no_alternative if the input is an error there
+    [[nodiscard]] index_t predict(grammar::token_t nonterminal,
+                                  size_t           terminal) const;
+
+    [[nodiscard]] const std::vector<conflict> & conflicts() const {
+        return conflict_list;
+    }
+
+    [[nodiscard]] bool is_ll1() const { return conflict_list.empty(); }
+
+    [[nodiscard]] size_t entry_count() const { return entries.size(); }
+
+   private:
+    struct entry {
+        index_t terminal;
+        index_t alternative;
+    };
+
+    // The entries of nonterminal A are entries[starts[A], starts[A + 1])
+    std::vector<index_t>  starts;
+    std::vector<entry>    entries{};
+    std::vector<conflict> conflict_list{};
+};
+
+#endif
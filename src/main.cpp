@@ -1,106 +1,96 @@
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <optional>
 #include <string>
+#include <utility>
 
-#include "grammar.hpp"
-#include "grammar_transform.hpp"
+#include "diagnostics.hpp"
+#include "driver.hpp"
+#include "instrumentation.hpp"
+#include "options.hpp"
+#include "pass_context.hpp"
+#include "thread_pool.hpp"
 
-std::string read_file(std::istream & file) {
-    std::stringstream content{};
-    {
-        std::string line;
-        while (std::getline(file, line)) { content << line << '\n'; }
+// Returns false if the report could not be written
+bool write_report(const std::string &     filename,
+                  const instrumentation & stats, diagnostics & diag) {
+    if (filename == "-") {
+        stats.write_json(std::cout);
+        return true;
     }
-    return content.str();
-}
 
-std::string read_cfg_data(int arg_count, const char ** args) {
-    std::string filename;
-    {
-        int arg_num = 1;
-        while (args[arg_num] != nullptr) {
-            if (arg_num == arg_count - 1) { filename = args[arg_num]; }
-            arg_num++;
-            if (filename == "-h" or filename == "--help") return "";
-        }
-    }
+    std::ofstream out{filename};
+    if (out) stats.write_json(out);
 
-    if (filename.empty()) {
-        std::cout << "Enter a file that contains a grammar: ";
-        std::cin >> filename;
-        std::ifstream file{filename};
-        return read_file(file);
-    } else if (filename == "-" or filename == "--") {
-        return read_file(std::cin);
-    } else {
-        std::ifstream file{filename};
-        return read_file(file);
+    if (not out) {
+        diag.error("Could not write the report to ", filename, '\n');
+        return false;
     }
+    return true;
 }
 
 int main(int arg_count, const char ** args) {
-    const auto data = read_cfg_data(arg_count, args);
-
-    if (data.empty()) {
-        std::cout << args[0] << '\n'
-                  << "Usage:\n\tno args -> filename in stdin\n\t-h or --help "
-                     "-> this help message\n"
-                  << "\t- or -- -> grammar in stdin\n\t<filename> -> file read "
-                     "as grammar"
-                  << std::endl;
-        return 0;
-    }
+    std::ios::sync_with_stdio(false);
 
-    auto cfg = grammar::empty();
-    if (const auto input = grammar::parse_from_file(data); input)
-        cfg = input.value();
-    else {
-        std::cout << "Error occurred in parsing" << std::endl;
+    auto opts = parse_options(arg_count, args, std::cerr);
+    if (not opts) {
+        print_usage(std::cerr, args[0]);
         return 1;
     }
 
-    std::cout << cfg << '\n';
+    if (opts->show_help) {
+        print_usage(std::cout, args[0]);
+        return 0;
+    }
 
-    std::cout << "Epsilon check\n";
-    const auto nonterms = cfg.nonterminals();
-    for (const auto & nonterm : nonterms) {
-        std::cout << std::boolalpha << nonterm << " has epsilon? "
-                  << cfg.has_empty_production(nonterm) << std::endl;
+    if (opts->filenames.empty() and opts->manifest.empty()) {
+        std::string filename{};
+        std::cout << "Enter a file that contains a grammar: " << std::flush;
+        std::cin >> filename;
+        opts->filenames.push_back(std::move(filename));
     }
 
-    std::cout << "\nCycle check" << std::endl;
-    const auto cycle_path = cfg.cyclic_path();
-    if (not cycle_path.empty()) {
-        std::cout << "Found cycle\n";
-        bool print_arrow = false;
-        for (const auto & node : cycle_path) {
-            if (print_arrow) {
-                std::cout << " --> ";
-            } else {
-                print_arrow = true;
-            }
-            std::cout << node;
+    const auto inputs = collect_inputs(*opts, std::cerr);
+    if (not inputs) return 1;
+
+    // A directory is a batch even if it only holds one grammar,
+    // as is a manifest, which may be given without any file names
+    if (not opts->manifest.empty() or not opts->output_dir.empty()
+        or inputs->size() != 1 or opts->filenames.empty()
+        or inputs->front() != opts->filenames.front()) {
+        if (not opts->report_file.empty() or not opts->binary_output.empty()
+            or not opts->incremental_file.empty()) {
+            std::cerr << "--report, --emit-binary, and --incremental can only "
+                         "be used with a single grammar\n";
+            return 1;
         }
-        std::cout << '\n';
-    } else {
-        std::cout << "Could not find cycle\n";
+
+        const auto failures = process_batch(*inputs, *opts, std::cout);
+        trim_cache(*opts);
+        if (failures != 0)
+            std::cerr << failures << " of " << inputs->size()
+                      << " grammars failed\n";
+        return failures == 0 ? 0 : 1;
     }
 
-    std::cout << "Making cfg proper\n";
-    auto proper = make_proper_form(cfg);
+    diagnostics     diag{opts->verbosity};
+    instrumentation stats{};
+    pass_context    ctx{diag};
+    if (not opts->report_file.empty()) ctx.stats = &stats;
 
-    std::cout << proper << std::endl;
+    // The output is the same for any number of threads
+    std::optional<thread_pool> pool{};
+    if (opts->jobs != 1) ctx.pool = &pool.emplace(opts->jobs);
 
-    auto cleaned = remove_left_recursion(proper);
+    const bool succeeded
+        = process_grammar(inputs->front(), *opts, ctx, std::cout);
+    trim_cache(*opts);
 
-    if (cleaned) {
-        std::cout << "Removed all left recursion from the grammar" << std::endl;
-        auto result = cleaned.value();
-        std::cout << result << std::endl;
-    } else {
-        std::cout << "Could not clean the grammar" << std::endl;
-    }
+    // The report is written even if a pass failed,
+    // as it shows which pass that was
+    if (not opts->report_file.empty()
+        and not write_report(opts->report_file, stats, diag))
+        return 1;
 
-    std::cout << "END OF PROGRAM" << std::endl;
+    return succeeded ? 0 : 1;
 }
@@ -0,0 +1,85 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAS_MMAP 1
+#else
+#define HAS_MMAP 0
+#endif
+
+std::optional<mapped_file> mapped_file::open(const std::string & filename) {
+    mapped_file to_ret{};
+
+#if HAS_MMAP
+    const auto descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0) return std::optional<mapped_file>{};
+
+    struct stat info {};
+    if (fstat(descriptor, &info) != 0) {
+        close(descriptor);
+        return std::optional<mapped_file>{};
+    }
+
+    // Empty files cannot be mapped, but are perfectly valid
+    if (info.st_size > 0) {
+        auto * address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+                              descriptor, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            to_ret.data = static_cast<const char *>(address);
+            to_ret.size = static_cast<size_t>(info.st_size);
+            close(descriptor);
+            return std::optional{std::move(to_ret)};
+        }
+    }
+    close(descriptor);
+
+    // Not a regular file (e.g. a pipe), so read it instead
+    if (info.st_size == 0 and S_ISREG(info.st_mode))
+        return std::optional{std::move(to_ret)};
+#endif
+
+    std::ifstream file{filename, std::ios::binary};
+    if (not file) return std::optional<mapped_file>{};
+
+    to_ret.fallback.assign(std::istreambuf_iterator<char>{file},
+                           std::istreambuf_iterator<char>{});
+    to_ret.data = to_ret.fallback.data();
+    to_ret.size = to_ret.fallback.size();
+    return std::optional{std::move(to_ret)};
+}
+
+mapped_file::mapped_file(mapped_file && other) noexcept {
+    *this = std::move(other);
+}
+
+mapped_file & mapped_file::operator=(mapped_file && other) noexcept {
+    if (this == &other) return *this;
+
+    release();
+    const auto was_fallback = other.data == other.fallback.data();
+
+    fallback   = std::move(other.fallback);
+    size       = std::exchange(other.size, 0);
+    data       = was_fallback ? fallback.data() : other.data;
+    other.data = nullptr;
+    return *this;
+}
+
+mapped_file::~mapped_file() { release(); }
+
+void mapped_file::release() {
+#if HAS_MMAP
+    if (data != nullptr and data != fallback.data())
+        munmap(const_cast<char *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
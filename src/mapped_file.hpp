@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A read-only view of a whole file.
+// Where memory mapping is available, the file is mapped instead of copied,
+// so the only copy of the contents is the operating system's page cache.
+class mapped_file final {
+   public:
+    [[nodiscard]] static std::optional<mapped_file> open(
+        const std::string & filename);
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file & operator=(const mapped_file &) = delete;
+
+    mapped_file(mapped_file && other) noexcept;
+    mapped_file & operator=(mapped_file && other) noexcept;
+
+    ~mapped_file();
+
+    [[nodiscard]] std::string_view view() const { return {data, size}; }
+
+   private:
+    mapped_file() = default;
+
+    void release();
+
+    const char * data = nullptr;
+    size_t       size = 0;
+    // Only used where the file could not be mapped
+    std::string fallback{};
+};
+
+#endif
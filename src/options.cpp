@@ -0,0 +1,185 @@
+#include "options.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <ostream>
+#include <string_view>
+
+std::optional<options> parse_options(int            arg_count,
+                                     const char **  args,
+                                     std::ostream & err) {
+    options to_ret{};
+
+    for (int arg_num = 1; arg_num < arg_count; ++arg_num) {
+        const std::string_view arg{args[arg_num]};
+
+        // Consumes the argument after an option, such as a file name.
+        // Null if there is none.
+        const auto value = [&arg_num, arg_count, args, &arg,
+                            &err]() -> const char * {
+            if (++arg_num < arg_count) return args[arg_num];
+            err << arg << " needs a value\n";
+            return nullptr;
+        };
+
+        // Consumes a whole number after an option.
+        // Returns nothing if there is none, after explaining that the
+        // option needs `what`.
+        const auto number
+            = [&](const char * what) -> std::optional<unsigned long long> {
+            const auto * text = value();
+            if (text == nullptr) return std::optional<unsigned long long>{};
+
+            char *     end    = nullptr;
+            const auto to_ret = std::strtoull(text, &end, 10);
+            if (*text == '\0' or *end != '\0') {
+                err << arg << " needs " << what << '\n';
+                return std::optional<unsigned long long>{};
+            }
+            return std::optional{to_ret};
+        };
+
+        if (arg == "-h" or arg == "--help") {
+            to_ret.show_help = true;
+        } else if (arg == "-q" or arg == "--quiet") {
+            to_ret.verbosity = log_level::quiet;
+        } else if (arg == "-v" or arg == "--verbose") {
+            to_ret.verbosity = log_level::verbose;
+        } else if (arg == "--report") {
+            const auto * file = value();
+            if (file == nullptr) return std::optional<options>{};
+            to_ret.report_file = file;
+        } else if (arg == "-j" or arg == "--jobs") {
+            const auto count = number("a number of threads");
+            if (not count) return std::optional<options>{};
+            to_ret.jobs = *count;
+        } else if (arg == "--manifest") {
+            const auto * file = value();
+            if (file == nullptr) return std::optional<options>{};
+            to_ret.manifest = file;
+        } else if (arg == "-o" or arg == "--output-dir") {
+            const auto * dir = value();
+            if (dir == nullptr) return std::optional<options>{};
+            to_ret.output_dir = dir;
+        } else if (arg == "-t" or arg == "--text") {
+            to_ret.text_output = true;
+        } else if (arg == "--input-binary") {
+            to_ret.binary_input = true;
+        } else if (arg == "--emit-binary") {
+            const auto * file = value();
+            if (file == nullptr) return std::optional<options>{};
+            to_ret.binary_output = file;
+        } else if (arg == "--by-components") {
+            to_ret.by_components = true;
+        } else if (arg == "--left-factor") {
+            to_ret.left_factor = true;
+        } else if (arg == "--ll1") {
+            to_ret.ll1 = true;
+        } else if (arg == "--recognize") {
+            const auto * file = value();
+            if (file == nullptr) return std::optional<options>{};
+            to_ret.corpus = file;
+        } else if (arg == "--incremental") {
+            const auto * file = value();
+            if (file == nullptr) return std::optional<options>{};
+            to_ret.incremental_file = file;
+        } else if (arg == "--cache-dir") {
+            const auto * dir = value();
+            if (dir == nullptr) return std::optional<options>{};
+            to_ret.cache_dir = dir;
+        } else if (arg == "--cache-size") {
+            const auto megabytes = number("a number of MiB");
+            if (not megabytes) return std::optional<options>{};
+            to_ret.cache_size = std::uintmax_t{*megabytes} << 20u;
+        } else if (arg == "--max-alternatives") {
+            const auto count = number("a number of alternatives");
+            if (not count) return std::optional<options>{};
+            to_ret.max_alternatives = *count;
+        } else if (arg == "--max-tokens") {
+            const auto count = number("a number of tokens");
+            if (not count) return std::optional<options>{};
+            to_ret.max_tokens = *count;
+        } else if (arg == "--max-memory") {
+            const auto megabytes = number("a number of MiB");
+            if (not megabytes) return std::optional<options>{};
+            to_ret.max_memory = std::uintmax_t{*megabytes} << 20u;
+        } else if (arg == "--time-limit") {
+            const auto * seconds = value();
+            if (seconds == nullptr) return std::optional<options>{};
+
+            char *     end   = nullptr;
+            const auto limit = std::strtod(seconds, &end);
+            // Much longer limits would overflow the clock's deadline
+            if (*seconds == '\0' or *end != '\0' or not(limit >= 0)
+                or limit > 1e9) {
+                err << arg << " needs a number of seconds\n";
+                return std::optional<options>{};
+            }
+            // Rounded up, as a limit of 0 ms would mean no limit at all
+            to_ret.time_limit = std::chrono::milliseconds{
+                static_cast<std::chrono::milliseconds::rep>(
+                    std::ceil(limit * 1000))};
+        } else if (arg.size() > 1 and arg.front() == '-' and arg != "--") {
+            err << "Unknown option " << arg << '\n';
+            return std::optional<options>{};
+        } else {
+            to_ret.filenames.emplace_back(arg);
+        }
+    }
+
+    if (to_ret.by_components and not to_ret.incremental_file.empty()) {
+        err << "--by-components cannot be used with --incremental\n";
+        return std::optional<options>{};
+    }
+
+    return to_ret;
+}
+
+void print_usage(std::ostream & out, const char * program_name) {
+    out << program_name << '\n'
+        << "Usage:\n\tno args -> filename in stdin\n\t-h or --help "
+           "-> this help message\n"
+        << "\t- or -- -> grammar in stdin\n\t<filename> -> file read "
+           "as grammar\n"
+        << "\t<filename> <filename>... or <directory> -> every grammar, "
+           "in order\n"
+        << "Options:\n"
+        << "\t-q or --quiet -> only print the resulting grammar and errors\n"
+        << "\t-v or --verbose -> also print every intermediate step\n"
+        << "\t--report <file> -> write the time, allocations, and sizes of "
+           "every pass as JSON (- for stdout)\n"
+        << "\t-j <n> or --jobs <n> -> run the transforms on n threads "
+           "(0 for all cores); with several grammars, run n at once\n"
+        << "\t--manifest <file> -> also read the grammars listed one per line "
+           "in the file (- for stdin)\n"
+        << "\t-o <dir> or --output-dir <dir> -> write the result for each "
+           "grammar to <dir>/<name>.out instead of stdout\n"
+        << "\t-t or --text -> print the resulting grammar in the input "
+           "format, so it can be read again\n"
+        << "\t--input-binary -> read grammars saved by --emit-binary\n"
+        << "\t--emit-binary <file> -> also save the resulting grammar in "
+           "the binary format\n"
+        << "\t--by-components -> only substitute between nonterminals which "
+           "are left recursive through each other\n"
+        << "\t--left-factor -> give alternatives sharing a prefix one "
+           "alternative and a fresh nonterminal for the rest\n"
+        << "\t--ll1 -> build the LL(1) table of the resulting grammar "
+           "and report its conflicts\n"
+        << "\t--recognize <file> -> recognize each line of the file with "
+           "the resulting grammar and report how many were accepted "
+           "and how fast\n"
+        << "\t--incremental <file> -> reuse the results kept in the file "
+           "for every unchanged nonterminal, then keep this run's there\n"
+        << "\t--cache-dir <dir> -> share results through the directory, "
+           "so grammars seen before are not transformed again\n"
+        << "\t--cache-size <n> -> keep at most n MiB in the cache, "
+           "dropping the least recently used results (256)\n"
+        << "\t--max-alternatives <n> -> stop a grammar whose passes build "
+           "more than n alternatives\n"
+        << "\t--max-tokens <n> -> stop a grammar whose passes build "
+           "more than n tokens\n"
+        << "\t--max-memory <n> -> stop once the process uses more than "
+           "n MiB (Linux only)\n"
+        << "\t--time-limit <s> -> stop a grammar which takes more than "
+           "s seconds\n";
+}
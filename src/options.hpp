@@ -0,0 +1,73 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+
+// The command line options of check_grammar
+struct options {
+    bool      show_help = false;
+    log_level verbosity = log_level::normal;
+    // Empty if the user should be asked for one,
+    // "-" or "--" for stdin.
+    // Directories stand for every file inside them.
+    std::vector<std::string> filenames{};
+    // Where to write the per-pass JSON report, "-" for stdout.
+    // Empty if no report was asked for.
+    std::string report_file{};
+    // Threads for the transforms, 0 for one per hardware thread.
+    // In batch mode, the number of grammars processed at once.
+    size_t jobs = 1;
+    // A file listing more grammars, one per line, "-" for stdin
+    std::string manifest{};
+    // Where to write one result file per grammar.
+    // Empty for one combined stream on stdout.
+    std::string output_dir{};
+    // Whether the grammars are in the binary format instead of text
+    bool binary_input = false;
+    // Whether to print the resulting grammar in the input format
+    bool text_output = false;
+    // Where to save the resulting grammar in the binary format.
+    // Empty if it should not be saved.
+    std::string binary_output{};
+    // Whether to remove left recursion one cycle of left corners at a time
+    bool by_components = false;
+    // Whether to left factor the grammar once left recursion is removed
+    bool left_factor = false;
+    // Whether to build the LL(1) table of the result and report conflicts
+    bool ll1 = false;
+    // A file of sample strings, one per line, to recognize with the result.
+    // Empty if there is none.
+    std::string corpus{};
+    // Where the results of the last run are kept for reuse.
+    // Empty if every nonterminal should be rewritten.
+    std::string incremental_file{};
+    // Where finished results are shared between runs.
+    // Empty if every grammar should be transformed.
+    std::string cache_dir{};
+    // How many bytes of results the cache may keep
+    std::uintmax_t cache_size = std::uintmax_t{256} << 20u;
+    // Limits on the transforms of each grammar, 0 for none.
+    // The size limits apply to the grammar each pass builds,
+    // the memory limit to the whole process.
+    size_t                    max_alternatives = 0;
+    size_t                    max_tokens       = 0;
+    std::uintmax_t            max_memory       = 0;
+    std::chrono::milliseconds time_limit{0};
+};
+
+// Returns nothing if the arguments are invalid,
+// after explaining why on `err`
+[[nodiscard]] std::optional<options> parse_options(int           arg_count,
+                                                   const char ** args,
+                                                   std::ostream & err);
+
+void print_usage(std::ostream & out, const char * program_name);
+
+#endif
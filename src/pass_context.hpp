@@ -0,0 +1,46 @@
+#ifndef PASS_CONTEXT_HPP
+#define PASS_CONTEXT_HPP
+
+#include "diagnostics.hpp"
+#include "instrumentation.hpp"
+#include "resource_budget.hpp"
+#include "scratch_arena.hpp"
+#include "thread_pool.hpp"
+
+// Everything a transform needs besides the grammar itself
+struct pass_context final {
+    diagnostics & diag;
+    // Where each pass records its cost, or nullptr to record nothing
+    instrumentation * stats = nullptr;
+    // Scratch memory, released at the end of every pass
+    scratch_arena scratch{};
+    // Where passes run their per-nonterminal loops, or nullptr to run them
+    // on the calling thread
+    thread_pool * pool = nullptr;
+    // What the passes may use before they give up with resource_exhausted
+    resource_limits limits{};
+
+    // The context used when none is given: standard diagnostics, no stats.
+    // Each thread has its own, as the scratch arena must not be shared.
+    static pass_context & standard() {
+        thread_local pass_context instance{diagnostics::standard()};
+        return instance;
+    }
+
+    // The number of distinct workers parallel_for may pass to func
+    [[nodiscard]] size_t workers() const {
+        return pool != nullptr ? pool->size() : 1;
+    }
+
+    // Calls func(index, worker) for every index in [0, count),
+    // on the pool if there is one
+    template<typename func_t>
+    void parallel_for(size_t count, func_t && func) {
+        if (pool != nullptr)
+            pool->parallel_for(count, func);
+        else
+            for (size_t index = 0; index < count; ++index) func(index, 0);
+    }
+};
+
+#endif
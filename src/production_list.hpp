@@ -0,0 +1,187 @@
+#ifndef PRODUCTION_LIST_HPP
+#define PRODUCTION_LIST_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+// A non-owning view over the tokens of one alternative.
+// It stays valid until the production_list it came from is modified.
+template<typename token_t>
+class rule_view final {
+   public:
+    constexpr rule_view() = default;
+    constexpr rule_view(const token_t * first, const token_t * last)
+        : first{first}
+        , last{last} {}
+
+    [[nodiscard]] constexpr const token_t * begin() const { return first; }
+    [[nodiscard]] constexpr const token_t * end() const { return last; }
+
+    [[nodiscard]] constexpr size_t size() const { return last - first; }
+    [[nodiscard]] constexpr bool   empty() const { return first == last; }
+
+    [[nodiscard]] constexpr const token_t & front() const { return *first; }
+    [[nodiscard]] constexpr const token_t & back() const { return *(last - 1); }
+    [[nodiscard]] constexpr const token_t & operator[](size_t index) const {
+        return first[index];
+    }
+
+    // Drops the first `count` tokens
+    [[nodiscard]] constexpr rule_view subview(size_t count) const {
+        return rule_view{first + count, last};
+    }
+
+   private:
+    const token_t * first = nullptr;
+    const token_t * last  = nullptr;
+
+    friend bool operator==(const rule_view & lhs, const rule_view & rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    friend bool operator!=(const rule_view & lhs, const rule_view & rhs) {
+        return not(lhs == rhs);
+    }
+};
+
+// Hashes the tokens of a rule, so that rules can be deduplicated
+// with the unordered containers
+template<typename token_t>
+struct rule_hash final {
+    size_t operator()(const rule_view<token_t> & rule) const noexcept {
+        // FNV-1a over the hashes of the tokens
+        size_t to_ret = 14695981039346656037ull;
+        for (const auto & token : rule) {
+            to_ret ^= std::hash<token_t>{}(token);
+            to_ret *= 1099511628211ull;
+        }
+        return to_ret;
+    }
+};
+
+// All of the alternatives of one nonterminal.
+// The tokens of every alternative are stored back to back in one array,
+// with a second array holding where each alternative ends.
+// Alternative i is therefore tokens[offsets[i], offsets[i + 1]).
+template<typename token_t>
+class production_list final {
+   public:
+    using rule_t = rule_view<token_t>;
+
+    class const_iterator final {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = rule_t;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = rule_t;
+
+        const_iterator(const production_list * list, size_t index)
+            : list{list}
+            , index{index} {}
+
+        rule_t           operator*() const { return (*list)[index]; }
+        const_iterator & operator++() {
+            ++index;
+            return *this;
+        }
+
+        friend bool operator==(const const_iterator & lhs,
+                               const const_iterator & rhs) {
+            return lhs.index == rhs.index;
+        }
+
+        friend bool operator!=(const const_iterator & lhs,
+                               const const_iterator & rhs) {
+            return lhs.index != rhs.index;
+        }
+
+        friend difference_type operator-(const const_iterator & lhs,
+                                         const const_iterator & rhs) {
+            return static_cast<difference_type>(lhs.index)
+                   - static_cast<difference_type>(rhs.index);
+        }
+
+       private:
+        const production_list * list;
+        size_t                  index;
+    };
+
+    production_list() = default;
+    production_list(std::initializer_list<std::initializer_list<token_t>> rules) {
+        for (const auto & rule : rules) add_alternative(rule.begin(), rule.end());
+    }
+
+    // The number of alternatives
+    [[nodiscard]] size_t size() const { return offsets.size() - 1; }
+    [[nodiscard]] bool   empty() const { return size() == 0; }
+
+    [[nodiscard]] size_t token_count() const { return tokens.size(); }
+
+    // Every token of every alternative, without separators
+    [[nodiscard]] const std::vector<token_t> & all_tokens() const {
+        return tokens;
+    }
+
+    [[nodiscard]] rule_t operator[](size_t index) const {
+        const auto * base = tokens.data();
+        return rule_t{base + offsets[index], base + offsets[index + 1]};
+    }
+
+    [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+    [[nodiscard]] const_iterator end() const { return {this, size()}; }
+
+    // Opens a new, empty alternative at the end
+    void start_alternative() { offsets.push_back(offsets.back()); }
+
+    // Appends a token to the last alternative
+    void append(token_t token) {
+        tokens.push_back(token);
+        offsets.back() = static_cast<offset_t>(tokens.size());
+    }
+
+    template<typename iter_t>
+    void add_alternative(iter_t first, iter_t last) {
+        tokens.insert(tokens.end(), first, last);
+        offsets.push_back(static_cast<offset_t>(tokens.size()));
+    }
+
+    void add_alternative(rule_t rule) {
+        add_alternative(rule.begin(), rule.end());
+    }
+
+    // Appends all of the alternatives of `other`, which must not be *this
+    void append_alternatives(const production_list & other) {
+        for (const auto rule : other) add_alternative(rule);
+    }
+
+    // Removes the last alternative, which must exist
+    void pop_alternative() {
+        offsets.pop_back();
+        tokens.resize(offsets.back());
+    }
+
+    // Removes every alternative, but keeps the memory for reuse
+    void clear() {
+        tokens.clear();
+        offsets.resize(1);
+    }
+
+    void reserve(size_t alternatives, size_t token_total) {
+        offsets.reserve(alternatives + 1);
+        tokens.reserve(token_total);
+    }
+
+   private:
+    using offset_t = std::uint32_t;
+
+    std::vector<token_t>  tokens{};
+    std::vector<offset_t> offsets{0};
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "recognizer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+using token_t = grammar::token_t;
+
+namespace {
+    void sort_unique(std::vector<std::uint32_t> & positions) {
+        std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()),
+                        positions.end());
+    }
+}  // namespace
+
+recognizer::recognizer(const grammar & input)
+    : cfg{input}
+    , start{input.nonterminals().front()}
+    , sets{input}
+    , table{input, sets} {
+    for (const auto terminal : input.terminals())
+        longest_terminal = std::max(
+            longest_terminal,
+            static_cast<const std::string &>(input.symbol_of(terminal))
+                .size());
+}
+
+std::optional<std::vector<token_t>> recognizer::tokenize(
+    std::string_view text) const {
+    std::vector<token_t> to_ret{};
+    for (size_t pos = 0; pos < text.size();) {
+        if (std::isspace(static_cast<unsigned char>(text[pos])) != 0) {
+            ++pos;
+            continue;
+        }
+
+        auto length = std::min(longest_terminal, text.size() - pos);
+        for (; length != 0; --length)
+            if (const auto token = cfg.token_of(text.substr(pos, length));
+                token and *token < 0) {
+                to_ret.push_back(*token);
+                break;
+            }
+
+        if (length == 0) return std::optional<std::vector<token_t>>{};
+        pos += length;
+    }
+    return to_ret;
+}
+
+bool recognizer::accepts(const std::vector<token_t> & input) {
+    return predictive() ? accepts_predictive(input) : accepts_memoized(input);
+}
+
+bool recognizer::accepts_predictive(const std::vector<token_t> & input) {
+    stack.assign(1, start);
+    size_t pos = 0;
+
+    while (not stack.empty()) {
+        const auto top = stack.back();
+        stack.pop_back();
+
+        if (top < 0) {
+            if (pos == input.size() or input[pos] != top) return false;
+            ++pos;
+            continue;
+        }
+
+        const auto lookahead = pos < input.size()
+                                   ? ll1_sets::terminal_index(input[pos])
+                                   : sets.end_of_input();
+        const auto alternative = table.predict(top, lookahead);
+        if (alternative == ll1_table::no_alternative) return false;
+
+        // Pushed in reverse, so the first symbol is matched first
+        const auto rule = cfg.alternatives(top)[alternative];
+        for (auto index = rule.size(); index-- > 0;)
+            stack.push_back(rule[index]);
+    }
+
+    return pos == input.size();
+}
+
+bool recognizer::accepts_memoized(const std::vector<token_t> & input) {
+    text = &input;
+    memo.clear();
+    ends.clear();
+
+    // The ends are sorted, so the end of the input would be the last one
+    const auto [first, last] = ends_of(start, 0, 0);
+    return first != last and ends[last - 1] == input.size();
+}
+
+recognizer::range_t recognizer::ends_of(token_t    nonterminal,
+                                        position_t start, size_t depth) {
+    const auto & input = *text;
+
+    // Only the empty string can be derived if the next terminal
+    // cannot start anything else
+    if (start == input.size()
+        or not sets.first(nonterminal)
+                   .test(ll1_sets::terminal_index(input[start]))) {
+        if (not sets.nullable(nonterminal)) return range_t{0, 0};
+        ends.push_back(start);
+        const auto last = static_cast<std::uint32_t>(ends.size());
+        return range_t{last - 1, last};
+    }
+
+    // A call which is already in progress finds nothing,
+    // which only happens with left recursion
+    const auto key = (std::uint64_t{static_cast<std::uint32_t>(
+                          static_cast<int>(nonterminal))}
+                      << 32u)
+                     | start;
+    if (const auto [found, added] = memo.try_emplace(key, range_t{0, 0});
+        not added)
+        return found->second;
+
+    if (levels.size() == depth) levels.emplace_back();
+    auto & [result, current, next] = levels[depth];
+    result.clear();
+
+    for (const auto rule : cfg.alternatives(nonterminal)) {
+        current.assign(1, start);
+        for (const auto token : rule) {
+            next.clear();
+            for (const auto pos : current)
+                if (token < 0) {
+                    if (pos < input.size() and input[pos] == token)
+                        next.push_back(pos + 1);
+                } else {
+                    const auto [first, last] = ends_of(token, pos, depth + 1);
+                    next.insert(next.end(), ends.begin() + first,
+                                ends.begin() + last);
+                }
+
+            sort_unique(next);
+            std::swap(current, next);
+            if (current.empty()) break;
+        }
+        result.insert(result.end(), current.begin(), current.end());
+    }
+    sort_unique(result);
+
+    // Looked up again, as the calls above may have rehashed the memo
+    const auto    first = static_cast<std::uint32_t>(ends.size());
+    const range_t to_ret{first,
+                         first + static_cast<std::uint32_t>(result.size())};
+    ends.insert(ends.end(), result.begin(), result.end());
+    memo[key] = to_ret;
+    return to_ret;
+}
@@ -0,0 +1,81 @@
+#ifndef RECOGNIZER_HPP
+#define RECOGNIZER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "grammar.hpp"
+#include "ll1.hpp"
+
+// Decides whether strings of terminals are in the language of a grammar,
+// starting from the nonterminal with the smallest token.
+//
+// An LL(1) grammar is recognized by a predictive parser driven by its
+// ll1_table, in time linear in the input.
+// Any other grammar is recognized by a memoized parser, which finds every
+// position each nonterminal can end at from each position it is tried at.
+// Unlike a packrat parser it tries every alternative, so it recognizes the
+// same language as the grammar, as long as it has no left recursion.
+// A left recursive call finds nothing, so such a grammar may reject
+// strings in its language.
+//
+// The grammar must outlive the recognizer and not change.
+// A recognizer keeps its scratch memory between strings,
+// so it must only be used by one thread at a time.
+class recognizer final {
+   public:
+    explicit recognizer(const grammar & input);
+
+    [[nodiscard]] bool predictive() const { return table.is_ll1(); }
+
+    // Splits text into terminals, taking the longest terminal each time
+    // and skipping whitespace. Returns nothing if some part of the text
+    // is not a terminal of the grammar.
+    [[nodiscard]] std::optional<std::vector<grammar::token_t>> tokenize(
+        std::string_view text) const;
+
+    // `input` must only hold terminals
+    [[nodiscard]] bool accepts(const std::vector<grammar::token_t> & input);
+
+   private:
+    using position_t = std::uint32_t;
+    // Where a memoized result is in `ends`, as [first, last)
+    using range_t = std::pair<std::uint32_t, std::uint32_t>;
+
+    // The buffers for one level of the memoized parser's recursion
+    struct level {
+        std::vector<position_t> result{};
+        std::vector<position_t> current{};
+        std::vector<position_t> next{};
+    };
+
+    [[nodiscard]] bool accepts_predictive(
+        const std::vector<grammar::token_t> & input);
+    [[nodiscard]] bool accepts_memoized(
+        const std::vector<grammar::token_t> & input);
+
+    // The positions `nonterminal` can end at when it starts at `start`
+    range_t ends_of(grammar::token_t nonterminal, position_t start,
+                    size_t depth);
+
+    const grammar &  cfg;
+    grammar::token_t start;
+    ll1_sets         sets;
+    ll1_table        table;
+    size_t           longest_terminal = 0;
+
+    std::vector<grammar::token_t> stack{};
+
+    // The string being recognized by the memoized parser
+    const std::vector<grammar::token_t> *      text = nullptr;
+    std::unordered_map<std::uint64_t, range_t> memo{};
+    std::vector<position_t>                    ends{};
+    std::deque<level>                          levels{};
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "resource_budget.hpp"
+
+#include <fstream>
+
+#include "instrumentation.hpp"
+
+#if defined(__linux__)
+#include <unistd.h>
+#define HAS_PROC_STATM 1
+#else
+#define HAS_PROC_STATM 0
+#endif
+
+namespace {
+    // Reading the memory use takes a system call or two,
+    // so it is not done more often than this
+    constexpr auto memory_interval = std::chrono::milliseconds{1};
+
+    constexpr std::uintmax_t mebibyte = std::uintmax_t{1} << 20u;
+
+    // The resident memory of the process in bytes,
+    // or nothing where it cannot be measured
+    std::optional<std::uintmax_t> resident_bytes() {
+#if HAS_PROC_STATM
+        std::ifstream  statm{"/proc/self/statm"};
+        std::uintmax_t total_pages    = 0;
+        std::uintmax_t resident_pages = 0;
+        if (statm >> total_pages >> resident_pages)
+            return resident_pages
+                   * static_cast<std::uintmax_t>(sysconf(_SC_PAGESIZE));
+#endif
+        return std::optional<std::uintmax_t>{};
+    }
+}  // namespace
+
+resource_budget::resource_budget(const resource_limits & limits,
+                                 const char * pass, const grammar & input)
+    : limits{limits}
+    , pass{pass}
+    , names{input}
+    , limited{limits.any()} {
+    if (not limited) return;
+
+    if (limits.max_alternatives != 0 or limits.max_tokens != 0) {
+        const auto size = grammar_size::of(input);
+        alternative_count.store(size.alternatives, std::memory_order_relaxed);
+        token_count.store(size.tokens, std::memory_order_relaxed);
+    }
+
+    check(grammar::rule_sep);
+}
+
+void resource_budget::check_size(grammar::token_t nonterminal,
+                                 size_t alternatives, size_t tokens) const {
+    if (limits.max_alternatives != 0 and alternatives > limits.max_alternatives)
+        fail(nonterminal, "the grammar grew to " + std::to_string(alternatives)
+                              + " alternatives, over the limit of "
+                              + std::to_string(limits.max_alternatives));
+
+    if (limits.max_tokens != 0 and tokens > limits.max_tokens)
+        fail(nonterminal, "the grammar grew to " + std::to_string(tokens)
+                              + " tokens, over the limit of "
+                              + std::to_string(limits.max_tokens));
+}
+
+void resource_budget::check_process(grammar::token_t nonterminal) {
+    const auto now = std::chrono::steady_clock::now();
+    if (limits.deadline and now > *limits.deadline)
+        fail(nonterminal, "the time limit ran out");
+
+    if (limits.max_memory_bytes == 0) return;
+
+    // Only the worker which moves the time along measures the memory
+    auto       last = memory_checked.load(std::memory_order_relaxed);
+    const auto due  = (now - memory_interval).time_since_epoch().count();
+    if (last > due
+        or not memory_checked.compare_exchange_strong(
+            last, now.time_since_epoch().count(), std::memory_order_relaxed))
+        return;
+
+    if (const auto used = resident_bytes();
+        used and *used > limits.max_memory_bytes)
+        fail(nonterminal, "the process uses "
+                              + std::to_string((*used + mebibyte - 1) >> 20u)
+                              + " MiB, over the limit of "
+                              + std::to_string(limits.max_memory_bytes >> 20u)
+                              + " MiB");
+}
+
+void resource_budget::fail(grammar::token_t    nonterminal,
+                           const std::string & reason) const {
+    std::string message{pass};
+    if (nonterminal != grammar::rule_sep)
+        message += " stopped at "
+                   + static_cast<const std::string &>(
+                       names.symbol_of(nonterminal));
+    else
+        message += " did not start";
+    throw resource_exhausted{message + ": " + reason};
+}
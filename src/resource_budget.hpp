@@ -0,0 +1,104 @@
+#ifndef RESOURCE_BUDGET_HPP
+#define RESOURCE_BUDGET_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "grammar.hpp"
+
+// How far the transforms may go before giving up. Zero means no limit.
+struct resource_limits {
+    // The size of the grammar a pass is building
+    size_t max_alternatives = 0;
+    size_t max_tokens       = 0;
+    // The resident memory of the whole process
+    std::uintmax_t max_memory_bytes = 0;
+    // When the passes must have finished, if ever
+    std::optional<std::chrono::steady_clock::time_point> deadline{};
+
+    [[nodiscard]] bool any() const {
+        return max_alternatives != 0 or max_tokens != 0
+            or max_memory_bytes != 0 or deadline.has_value();
+    }
+};
+
+// Thrown by a pass which went over one of its limits.
+// The message names the pass and, if there was one,
+// the nonterminal it was working on.
+class resource_exhausted final : public std::runtime_error {
+   public:
+    using std::runtime_error::runtime_error;
+};
+
+// Keeps track of how big the grammar a pass is building has become,
+// and throws resource_exhausted once it or the process is over the limits.
+// Passes report every alternative they add or drop as they go,
+// so a pass which would blow up stops at the alternative which did it.
+// Safe to use from every worker of a parallel loop at once.
+// Without limits, every call returns straight away.
+class resource_budget final {
+   public:
+    // Starts from the size of `input`, and checks the time and memory
+    // so that a pass does not start once they have run out.
+    // `pass` must outlive the budget.
+    resource_budget(const resource_limits & limits, const char * pass,
+                    const grammar & input);
+
+    // `nonterminal` gained `alternatives` alternatives holding `tokens`
+    void grow(grammar::token_t nonterminal, size_t alternatives,
+              size_t tokens) {
+        if (not limited) return;
+        const auto before = alternative_count.fetch_add(
+            alternatives, std::memory_order_relaxed);
+        check_size(nonterminal, before + alternatives,
+                   token_count.fetch_add(tokens, std::memory_order_relaxed)
+                       + tokens);
+
+        // Even reading the clock is slow next to adding an alternative
+        if (before / check_interval
+            != (before + alternatives) / check_interval)
+            check(nonterminal);
+    }
+
+    // `alternatives` alternatives holding `tokens` were dropped
+    void shrink(size_t alternatives, size_t tokens) {
+        if (not limited) return;
+        alternative_count.fetch_sub(alternatives, std::memory_order_relaxed);
+        token_count.fetch_sub(tokens, std::memory_order_relaxed);
+    }
+
+    // Checks the time and memory, for loops which may not grow anything
+    // for a long while. Memory is only measured every so often.
+    void check(grammar::token_t nonterminal) {
+        if (limited and (limits.deadline or limits.max_memory_bytes != 0))
+            check_process(nonterminal);
+    }
+
+   private:
+    // How many alternatives grow adds between checks of the time and memory
+    static constexpr size_t check_interval = 64;
+
+    void check_size(grammar::token_t nonterminal, size_t alternatives,
+                    size_t tokens) const;
+    void check_process(grammar::token_t nonterminal);
+
+    [[noreturn]] void fail(grammar::token_t   nonterminal,
+                           const std::string & reason) const;
+
+    const resource_limits & limits;
+    const char *            pass;
+    const grammar &         names;
+    bool                    limited;
+
+    std::atomic<size_t> alternative_count{0};
+    std::atomic<size_t> token_count{0};
+    // When memory was last measured, in steady_clock ticks
+    std::atomic<std::chrono::steady_clock::rep> memory_checked{0};
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+namespace fs = std::filesystem;
+
+// Each file is laid out as 32-bit little-endian fields:
+//   magic, version, key length, proper length, cleaned length,
+// followed by the key and then both grammars in the binary format.
+
+namespace {
+    // "CFGR"
+    constexpr std::uint32_t magic = 0x52474643u;
+    // Bumped whenever the layout or the meaning of a key changes
+    constexpr std::uint32_t version = 1;
+
+    constexpr size_t field_size    = 4;
+    constexpr size_t header_fields = 5;
+
+    constexpr std::string_view extension = ".cfgr";
+    constexpr std::string_view temporary = ".tmp";
+
+    // Temporary files this old were left behind by a process which died
+    constexpr auto abandoned_after = std::chrono::hours{1};
+
+    void put(std::string & buffer, std::uint32_t value) {
+        for (unsigned byte = 0; byte < field_size; ++byte)
+            buffer += static_cast<char>((value >> (8 * byte)) & 0xffu);
+    }
+
+    [[nodiscard]] std::uint32_t get(const char * data) {
+        std::uint32_t to_ret = 0;
+        for (unsigned byte = 0; byte < field_size; ++byte)
+            to_ret |= static_cast<std::uint32_t>(
+                          static_cast<unsigned char>(data[byte]))
+                      << (8 * byte);
+        return to_ret;
+    }
+
+    [[nodiscard]] std::string hex(std::uint64_t value) {
+        static constexpr std::string_view digits = "0123456789abcdef";
+        std::string                       to_ret(16, '0');
+        for (auto & digit : to_ret) {
+            digit = digits[value >> 60u];
+            value <<= 4u;
+        }
+        return to_ret;
+    }
+
+    [[nodiscard]] std::uint64_t fnv1a(std::string_view data) {
+        std::uint64_t to_ret = 14695981039346656037ull;
+        for (const auto byte : data) {
+            to_ret ^= static_cast<unsigned char>(byte);
+            to_ret *= 1099511628211ull;
+        }
+        return to_ret;
+    }
+}  // namespace
+
+std::string result_cache::key_of(const grammar &     input,
+                                 const std::string & passes) {
+    std::ostringstream to_ret{};
+    to_ret << passes << '\n';
+    input.write_binary(to_ret);
+    return to_ret.str();
+}
+
+fs::path result_cache::path_of(const std::string & key) const {
+    return directory / (hex(fnv1a(key)) + std::string{extension});
+}
+
+std::optional<result_cache::result> result_cache::find(
+    const std::string & key) const {
+    const auto path = path_of(key);
+    const auto file = mapped_file::open(path.string());
+    if (not file) return std::optional<result>{};
+
+    const auto data = file->view();
+    if (data.size() < field_size * header_fields
+        or get(data.data()) != magic
+        or get(data.data() + field_size) != version)
+        return std::optional<result>{};
+
+    const size_t key_size     = get(data.data() + 2 * field_size);
+    const size_t proper_size  = get(data.data() + 3 * field_size);
+    const size_t cleaned_size = get(data.data() + 4 * field_size);
+
+    const size_t key_start = field_size * header_fields;
+    if (key_start + key_size + proper_size + cleaned_size != data.size()
+        or data.substr(key_start, key_size) != key)
+        return std::optional<result>{};
+
+    // A result which does not load is only a miss, so nothing is reported
+    std::ostringstream discarded{};
+    diagnostics        quiet{log_level::quiet, discarded, discarded};
+
+    auto proper  = grammar::parse_binary(
+        data.substr(key_start + key_size, proper_size), quiet);
+    auto cleaned = grammar::parse_binary(
+        data.substr(key_start + key_size + proper_size), quiet);
+    if (not proper or not cleaned) return std::optional<result>{};
+
+    // The modification time is what trim goes by
+    std::error_code error{};
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+
+    return result{std::move(*proper), std::move(*cleaned)};
+}
+
+bool result_cache::store(const std::string & key, const grammar & proper,
+                         const grammar & cleaned) const {
+    std::ostringstream proper_data{};
+    proper.write_binary(proper_data);
+    std::ostringstream cleaned_data{};
+    cleaned.write_binary(cleaned_data);
+
+    const auto proper_size  = proper_data.str().size();
+    const auto cleaned_size = cleaned_data.str().size();
+    if (std::max({key.size(), proper_size, cleaned_size}) > UINT32_MAX)
+        return false;
+
+    std::string buffer{};
+    buffer.reserve(field_size * header_fields + key.size() + proper_size
+                   + cleaned_size);
+    put(buffer, magic);
+    put(buffer, version);
+    put(buffer, static_cast<std::uint32_t>(key.size()));
+    put(buffer, static_cast<std::uint32_t>(proper_size));
+    put(buffer, static_cast<std::uint32_t>(cleaned_size));
+    buffer += key;
+    buffer += proper_data.str();
+    buffer += cleaned_data.str();
+
+    std::error_code error{};
+    fs::create_directories(directory, error);
+
+    // Another process may be storing the same result,
+    // so each writer has a name of its own
+    std::random_device random{};
+    const auto         path = path_of(key);
+    auto               temp = path;
+    temp += std::string{temporary} + '.'
+            + hex((std::uint64_t{random()} << 32u) ^ random());
+
+    {
+        std::ofstream file{temp, std::ios::binary};
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (not file) {
+            file.close();
+            fs::remove(temp, error);
+            return false;
+        }
+    }
+
+    fs::rename(temp, path, error);
+    if (error) {
+        fs::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+void result_cache::trim(std::uintmax_t max_bytes) const {
+    struct stored {
+        fs::file_time_type used;
+        std::uintmax_t     size;
+        fs::path           path;
+    };
+
+    std::vector<stored> results{};
+    std::uintmax_t      total = 0;
+    const auto          now   = fs::file_time_type::clock::now();
+
+    // Other processes may be adding and removing files meanwhile,
+    // so any file may be gone by the time it is looked at
+    std::error_code error{};
+    for (const auto & entry : fs::directory_iterator{directory, error}) {
+        std::error_code entry_error{};
+        const auto      name = entry.path().filename().string();
+        const auto      used = entry.last_write_time(entry_error);
+        const auto      size = entry.file_size(entry_error);
+        if (entry_error) continue;
+
+        if (name.find(temporary) != std::string::npos) {
+            if (now - used > abandoned_after) fs::remove(entry, entry_error);
+        } else if (entry.path().extension() == extension) {
+            results.push_back({used, size, entry.path()});
+            total += size;
+        }
+    }
+
+    if (total <= max_bytes) return;
+
+    std::sort(results.begin(), results.end(),
+              [](const stored & lhs, const stored & rhs) {
+                  return lhs.used < rhs.used;
+              });
+
+    for (const auto & oldest : results) {
+        if (total <= max_bytes) break;
+        if (fs::remove(oldest.path, error) or not error) total -= oldest.size;
+    }
+}
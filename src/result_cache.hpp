@@ -0,0 +1,51 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "grammar.hpp"
+
+// A directory of finished results, shared by every check_grammar run.
+// Each result is stored under a hash of its key, which is the input grammar
+// in the binary format and the passes run on it, so only grammars with the
+// same symbols, tokens, and rules share a result however they were written.
+//
+// Files are written to a temporary name and then renamed into place,
+// so processes sharing the directory only ever see whole files.
+// Each file holds its whole key, so a hash collision is only a miss.
+class result_cache final {
+   public:
+    // What the passes made of one grammar
+    struct result {
+        grammar proper;
+        grammar cleaned;
+    };
+
+    explicit result_cache(std::filesystem::path directory)
+        : directory{std::move(directory)} {}
+
+    // The key for running `passes` on `input`
+    [[nodiscard]] static std::string key_of(const grammar &     input,
+                                            const std::string & passes);
+
+    // Finding a result marks it as recently used
+    [[nodiscard]] std::optional<result> find(const std::string & key) const;
+
+    // Returns false if the result could not be written
+    bool store(const std::string & key, const grammar & proper,
+               const grammar & cleaned) const;
+
+    // Removes the least recently used results
+    // until the directory holds at most `max_bytes` of them
+    void trim(std::uintmax_t max_bytes) const;
+
+   private:
+    [[nodiscard]] std::filesystem::path path_of(const std::string & key) const;
+
+    std::filesystem::path directory;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SCRATCH_ARENA_HPP
+#define SCRATCH_ARENA_HPP
+
+#include <memory_resource>
+
+// Memory for the short-lived data of a transform,
+// such as the rules it builds up for one nonterminal at a time.
+// Freed blocks are pooled and reused within a pass,
+// and everything is handed back in one go when the pass ends,
+// so the scratch data costs a handful of mallocs per pass.
+class scratch_arena final {
+   public:
+    scratch_arena() = default;
+
+    scratch_arena(const scratch_arena &) = delete;
+    scratch_arena & operator=(const scratch_arena &) = delete;
+
+    [[nodiscard]] std::pmr::memory_resource * resource() { return &pool; }
+
+    // Every container using the arena must have been destroyed
+    void release() {
+        pool.release();
+        buffer.release();
+    }
+
+    // Releases the arena when it goes out of scope.
+    // Declared before any scratch containers, it outlives them.
+    class pass_scope final {
+       public:
+        explicit pass_scope(scratch_arena & arena) : arena{arena} {}
+        ~pass_scope() { arena.release(); }
+
+        pass_scope(const pass_scope &) = delete;
+        pass_scope & operator=(const pass_scope &) = delete;
+
+       private:
+        scratch_arena & arena;
+    };
+
+   private:
+    std::pmr::monotonic_buffer_resource    buffer{};
+    std::pmr::unsynchronized_pool_resource pool{&buffer};
+};
+
+#endif
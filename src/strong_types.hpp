@@ -1,6 +1,7 @@
 #ifndef STRONG_TYPES_HPP
 #define STRONG_TYPES_HPP
 
+#include <functional>
 #include <iosfwd>
 
 // This file defines a minimal strong type system. This prevents semantically
@@ -12,7 +13,7 @@ class strong_t final {
     constexpr strong_t() : internal_rep{} {}
     [[maybe_unused]] explicit constexpr strong_t(rep_t rep) : internal_rep{rep} {}
 
-    explicit constexpr operator rep_t() const { return internal_rep; }
+    explicit constexpr operator const rep_t &() const { return internal_rep; }
 
    private:
     rep_t internal_rep;
@@ -26,15 +27,15 @@ class strong_t final {
     // Both sides are this_t
 
     friend bool operator==(const this_t & lhs, const this_t & rhs) {
-        return static_cast<rep_t>(lhs) == static_cast<rep_t>(rhs);
+        return lhs.internal_rep == rhs.internal_rep;
     }
 
     friend bool operator!=(const this_t & lhs, const this_t & rhs) {
-        return static_cast<rep_t>(lhs) != static_cast<rep_t>(rhs);
+        return lhs.internal_rep != rhs.internal_rep;
     }
 
     friend bool operator<(const this_t & lhs, const this_t & rhs) {
-        return static_cast<rep_t>(lhs) < static_cast<rep_t>(rhs);
+        return lhs.internal_rep < rhs.internal_rep;
     }
 
     friend bool operator<=(const this_t & lhs, const this_t & rhs) {
@@ -81,4 +82,15 @@ class strong_t final {
 static_assert(sizeof(strong_t<int, struct tag>) == sizeof(int),
               "Strong types are not the size of their internal representation");
 
+// Strong types hash the same way as their internal representation,
+// so that they can be used as keys in the unordered containers
+namespace std {
+    template<typename rep_t, typename tag_t>
+    struct hash<strong_t<rep_t, tag_t>> {
+        size_t operator()(const strong_t<rep_t, tag_t> & value) const noexcept {
+            return hash<rep_t>{}(static_cast<const rep_t &>(value));
+        }
+    };
+}  // namespace std
+
 #endif
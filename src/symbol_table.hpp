@@ -0,0 +1,147 @@
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A bidirectional mapping between tokens and symbols.
+// Both directions are constant time:
+// tokens index straight into a vector (one for each sign),
+// while symbols are looked up through a hash map.
+// The tokens do not need to be contiguous, but holes waste space.
+//
+// Lookups by symbol take a std::string_view,
+// so callers never need to build a temporary string to find a symbol.
+template<typename token_t, typename symbol_t>
+class symbol_table final {
+   public:
+    symbol_table() = default;
+
+    // The hash map refers into the stored names,
+    // so copies have to rebuild it
+    symbol_table(const symbol_table & other) { *this = other; }
+    symbol_table & operator=(const symbol_table & other) {
+        if (this == &other) return *this;
+
+        names.clear();
+        non_negative.assign(other.non_negative.size(), nullptr);
+        negative.assign(other.negative.size(), nullptr);
+        tokens.clear();
+        tokens.reserve(other.tokens.size());
+        other.for_each(
+            [this](token_t token, const symbol_t & symbol) {
+                emplace(token, symbol);
+            });
+        return *this;
+    }
+
+    // std::deque does not move its elements, so the views stay valid
+    symbol_table(symbol_table &&)             = default;
+    symbol_table & operator=(symbol_table &&) = default;
+
+    [[nodiscard]] std::optional<token_t> find(std::string_view symbol) const {
+        if (const auto iter = tokens.find(symbol); iter != tokens.end())
+            return iter->second;
+        return {};
+    }
+
+    [[nodiscard]] bool contains(std::string_view symbol) const {
+        return tokens.count(symbol) != 0;
+    }
+
+    [[nodiscard]] std::optional<token_t> find(const symbol_t & symbol) const {
+        return find(std::string_view{static_cast<const std::string &>(symbol)});
+    }
+
+    [[nodiscard]] bool contains(const symbol_t & symbol) const {
+        return contains(
+            std::string_view{static_cast<const std::string &>(symbol)});
+    }
+
+    [[nodiscard]] bool contains(token_t token) const {
+        const auto * slot = this->slot(token);
+        return slot != nullptr and *slot != nullptr;
+    }
+
+    // The token must be in the table
+    [[nodiscard]] const symbol_t & at(token_t token) const {
+        return **this->slot(token);
+    }
+
+    // Both the token and the symbol must be unused
+    void emplace(token_t token, const symbol_t & symbol) {
+        const auto index = static_cast<int>(token);
+        auto &     side  = index >= 0 ? non_negative : negative;
+        const auto pos   = static_cast<size_t>(index >= 0 ? index : -index - 1);
+
+        if (side.size() <= pos) side.resize(pos + 1, nullptr);
+        const auto & stored = names.emplace_back(symbol);
+        side[pos]           = &stored;
+        tokens.emplace(static_cast<const std::string &>(stored), token);
+    }
+
+    // The token must be in the table.
+    // Unused tokens at either end are dropped,
+    // so max_token() and min_token() move back towards 0.
+    // The symbol itself stays allocated until the table is copied.
+    void erase(token_t token) {
+        const auto index = static_cast<int>(token);
+        auto &     side  = index >= 0 ? non_negative : negative;
+        const auto pos   = static_cast<size_t>(index >= 0 ? index : -index - 1);
+
+        tokens.erase(static_cast<const std::string &>(*side[pos]));
+        side[pos] = nullptr;
+        while (not side.empty() and side.back() == nullptr) side.pop_back();
+    }
+
+    [[nodiscard]] size_t size() const { return tokens.size(); }
+
+    // The largest token that could be in use, or 0 if there are none
+    [[nodiscard]] token_t max_token() const {
+        return token_t{non_negative.empty()
+                           ? 0
+                           : static_cast<int>(non_negative.size()) - 1};
+    }
+
+    // The smallest token that could be in use, or 0 if there are none
+    [[nodiscard]] token_t min_token() const {
+        return token_t{-static_cast<int>(negative.size())};
+    }
+
+    // Calls func(token, symbol) for every entry, with tokens in ascending order
+    template<typename func_t>
+    void for_each(func_t && func) const {
+        for (auto pos = negative.size(); pos > 0; --pos)
+            if (const auto * symbol = negative[pos - 1]; symbol != nullptr)
+                func(token_t{-static_cast<int>(pos)}, *symbol);
+
+        for (size_t pos = 0; pos < non_negative.size(); ++pos)
+            if (const auto * symbol = non_negative[pos]; symbol != nullptr)
+                func(token_t{static_cast<int>(pos)}, *symbol);
+    }
+
+   private:
+    [[nodiscard]] const symbol_t * const * slot(token_t token) const {
+        const auto   index = static_cast<int>(token);
+        const auto & side  = index >= 0 ? non_negative : negative;
+        const auto   pos   = static_cast<size_t>(index >= 0 ? index : -index - 1);
+        return pos < side.size() ? &side[pos] : nullptr;
+    }
+
+    // Owns every symbol; never reallocates existing elements
+    std::deque<symbol_t> names{};
+
+    // Index is the token, nullptr for unused tokens
+    std::vector<const symbol_t *> non_negative{};
+    // Index is -(token + 1), nullptr for unused tokens
+    std::vector<const symbol_t *> negative{};
+
+    // The keys refer into `names`
+    std::unordered_map<std::string_view, token_t> tokens{};
+};
+
+#endif
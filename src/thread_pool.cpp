@@ -0,0 +1,137 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#include "instrumentation.hpp"
+
+thread_pool::thread_pool(size_t thread_count)
+    : ranges(thread_count != 0
+                 ? thread_count
+                 : std::max(1u, std::thread::hardware_concurrency())) {
+    threads.reserve(ranges.size() - 1);
+    for (size_t worker = 1; worker < ranges.size(); ++worker)
+        threads.emplace_back([this, worker] {
+            size_t seen = 0;
+            while (true) {
+                {
+                    std::unique_lock guard{lock};
+                    start.wait(guard, [this, seen] {
+                        return stopping or generation != seen;
+                    });
+                    if (stopping) return;
+                    seen = generation;
+                }
+
+                const auto allocations = thread_allocation_count();
+                const auto bytes       = thread_allocated_bytes();
+                work(worker);
+                worker_allocations.fetch_add(
+                    thread_allocation_count() - allocations,
+                    std::memory_order_relaxed);
+                worker_bytes.fetch_add(thread_allocated_bytes() - bytes,
+                                       std::memory_order_relaxed);
+
+                std::lock_guard guard{lock};
+                if (--busy == 0) done.notify_one();
+            }
+        });
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard guard{lock};
+        stopping = true;
+    }
+    start.notify_all();
+    for (auto & thread : threads) thread.join();
+}
+
+void thread_pool::run(size_t count, void * context, body_t body) {
+    if (count == 0) return;
+
+    // A handful of chunks per worker keeps the locking cheap
+    // while leaving something to steal
+    const auto workers = size();
+    grain              = std::max<size_t>(1, count / (workers * 16));
+
+    for (size_t worker = 0; worker < workers; ++worker) {
+        auto & share = ranges[worker];
+        share.next   = count * worker / workers;
+        share.end    = count * (worker + 1) / workers;
+    }
+
+    this->context = context;
+    this->body    = body;
+    cancelled     = false;
+    error         = nullptr;
+
+    {
+        std::lock_guard guard{lock};
+        busy = threads.size();
+        ++generation;
+    }
+    start.notify_all();
+
+    work(0);
+
+    std::unique_lock guard{lock};
+    done.wait(guard, [this] { return busy == 0; });
+
+    if (error) std::rethrow_exception(error);
+}
+
+void thread_pool::work(size_t worker) {
+    size_t first = 0;
+    size_t last  = 0;
+    while (not cancelled and take(worker, first, last)) {
+        try {
+            for (auto index = first; index < last; ++index)
+                body(context, index, worker);
+        } catch (...) {
+            std::lock_guard guard{lock};
+            if (not error) error = std::current_exception();
+            cancelled = true;
+        }
+    }
+}
+
+bool thread_pool::take(size_t worker, size_t & first, size_t & last) {
+    {
+        auto &          own = ranges[worker];
+        std::lock_guard guard{own.lock};
+        if (own.next < own.end) {
+            first    = own.next;
+            last     = std::min(own.end, own.next + grain);
+            own.next = last;
+            return true;
+        }
+    }
+
+    // Steal the back half of the first worker with anything left.
+    // Only one range is locked at a time, so two thieves cannot deadlock.
+    const auto workers = size();
+    for (size_t offset = 1; offset < workers; ++offset) {
+        size_t stolen_end = 0;
+        {
+            auto &          victim = ranges[(worker + offset) % workers];
+            std::lock_guard guard{victim.lock};
+            if (victim.next >= victim.end) continue;
+
+            first      = victim.next + (victim.end - victim.next) / 2;
+            stolen_end = victim.end;
+            victim.end = first;
+        }
+
+        last = std::min(stolen_end, first + grain);
+
+        // Whatever is left of the stolen half becomes this worker's share.
+        // Its own range is empty, so nobody else is changing it.
+        auto &          own = ranges[worker];
+        std::lock_guard guard{own.lock};
+        own.next = last;
+        own.end  = stolen_end;
+        return true;
+    }
+
+    return false;
+}
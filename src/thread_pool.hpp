@@ -0,0 +1,97 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed set of threads for running loops whose iterations are independent.
+// Each worker starts with an equal share of the indices and takes them a
+// chunk at a time. A worker which runs out steals half of the indices
+// another worker has left, so uneven iterations still balance out.
+class thread_pool final {
+   public:
+    // Starts thread_count - 1 threads,
+    // as the thread calling parallel_for is a worker too.
+    // A thread_count of 0 means one per hardware thread.
+    explicit thread_pool(size_t thread_count);
+    ~thread_pool();
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool & operator=(const thread_pool &) = delete;
+
+    // The number of workers, including the calling thread
+    [[nodiscard]] size_t size() const { return ranges.size(); }
+
+    // Heap allocations made by the pool's own threads while running loops,
+    // which thread_allocation_count on the calling thread does not see
+    [[nodiscard]] size_t worker_allocation_count() const {
+        return worker_allocations.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] size_t worker_allocated_bytes() const {
+        return worker_bytes.load(std::memory_order_relaxed);
+    }
+
+    // Calls func(index, worker) for every index in [0, count),
+    // with worker in [0, size()), and returns once every call has returned.
+    // Calls made by the same worker never overlap.
+    // If a call throws, the remaining indices are skipped
+    // and the first exception is rethrown here.
+    // Must not be called from inside func.
+    template<typename func_t>
+    void parallel_for(size_t count, func_t && func) {
+        // The constness of func_t is restored before the call
+        auto * context = const_cast<void *>(static_cast<const void *>(&func));
+        run(count, context, [](void * context, size_t index, size_t worker) {
+            (*static_cast<std::remove_reference_t<func_t> *>(context))(index,
+                                                                      worker);
+        });
+    }
+
+   private:
+    using body_t = void (*)(void * context, size_t index, size_t worker);
+
+    // The indices a worker has yet to start, [next, end)
+    struct alignas(64) range {
+        std::mutex lock{};
+        size_t     next = 0;
+        size_t     end  = 0;
+    };
+
+    void run(size_t count, void * context, body_t body);
+    void work(size_t worker);
+    // Takes the next chunk of indices for the worker,
+    // stealing if it has none left. Returns false if every range is empty.
+    bool take(size_t worker, size_t & first, size_t & last);
+
+    std::vector<range>       ranges;
+    std::vector<std::thread> threads{};
+
+    // The current loop
+    void * context = nullptr;
+    body_t body    = nullptr;
+    size_t grain   = 1;
+
+    std::mutex              lock{};
+    std::condition_variable start{};
+    std::condition_variable done{};
+    // Bumped for every loop, so the threads know there is work
+    size_t generation = 0;
+    // Threads still working on the current loop
+    size_t busy     = 0;
+    bool   stopping = false;
+
+    std::atomic<bool>  cancelled{false};
+    std::exception_ptr error{};
+
+    std::atomic<size_t> worker_allocations{0};
+    std::atomic<size_t> worker_bytes{0};
+};
+
+#endif
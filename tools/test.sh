@@ -10,8 +10,103 @@ tools/build.sh 2> build_log.txt || exit
 test_log="test_log.txt"
 
 date > "$test_log"
-for file in tests/*; do
-    echo "$file" | tee -a "$test_log"
-    build/check_grammar "$file" 2>&1 | tee -a "$test_log"
-    echo ""
+# Every grammar is processed by one check_grammar, under a header naming it
+build/check_grammar --jobs 0 tests 2>&1 | tee -a "$test_log"
+
+# A manifest is a batch even with one grammar and no file names
+echo tests/example_grammar.txt \
+    | build/check_grammar --manifest - >> "$test_log" 2>&1 \
+    || echo "check_grammar failed on a manifest with one grammar"
+
+scratch="$(mktemp -d)"
+trap 'rm -rf "$scratch"' EXIT
+
+# The text written with --text must read back as the grammar which was
+# written, so it gives the same result as the binary form.
+# Symbols may be numbered differently, which only changes the line order.
+for grammar in tests/*.txt; do
+    build/check_grammar -q -t --emit-binary "$scratch/binary" "$grammar" \
+        > "$scratch/text" 2>&1
+    build/check_grammar -q -t "$scratch/text" > "$scratch/from_text" 2>&1 \
+        && build/check_grammar -q -t --input-binary "$scratch/binary" \
+            > "$scratch/from_binary" 2>&1 \
+        && [ "$(sort "$scratch/from_text")" = \
+             "$(sort "$scratch/from_binary")" ] \
+        || echo "The --text output of $grammar does not read back the same"
+done
+
+# A result found in --cache-dir, or rebuilt from --incremental, is the same
+# as one worked out from scratch. Only the progress messages differ:
+# a cache hit says so instead of "Making cfg proper" and the passes' messages,
+# and an incremental run says how much it reused.
+for grammar in tests/*.txt; do
+    build/check_grammar "$grammar" > "$scratch/plain" 2>&1
+
+    rm -rf "$scratch/cache"
+    build/check_grammar --cache-dir "$scratch/cache" "$grammar" \
+        > "$scratch/miss" 2>&1
+    build/check_grammar --cache-dir "$scratch/cache" "$grammar" \
+        > "$scratch/hit" 2>&1
+    cmp -s "$scratch/plain" "$scratch/miss" \
+        && grep -qx "Found the result in the cache" "$scratch/hit" \
+        && [ "$(awk '/^Making cfg proper$/ { skip = 1 }
+                     /^Symbol mapping/ { skip = 0 }
+                     !skip' "$scratch/miss")" = \
+             "$(grep -vx "Found the result in the cache" "$scratch/hit")" ] \
+        || echo "The result of $grammar from --cache-dir is not the same"
+
+    rm -f "$scratch/incremental"
+    build/check_grammar --incremental "$scratch/incremental" "$grammar" \
+        > "$scratch/miss" 2>&1
+    build/check_grammar --incremental "$scratch/incremental" "$grammar" \
+        > "$scratch/hit" 2>&1
+    grep -q "^Reused the results of \([0-9]*\) of \1 nonterminals$" \
+            "$scratch/hit" \
+        && [ "$(grep -v "^No results kept in\|^Reused the results of" \
+                "$scratch/miss")" = "$(cat "$scratch/plain")" ] \
+        && [ "$(grep -v "^Reused the results of" "$scratch/hit")" = \
+             "$(cat "$scratch/plain")" ] \
+        || echo "The result of $grammar from --incremental is not the same"
+done
+
+# Runs check_grammar with the given options on every grammar in tests/<dir>,
+# whose expected output is in tests/outputs/<dir>
+compare_outputs() {
+    dir="$1"
+    shift
+    for grammar in tests/"$dir"/*.txt; do
+        build/check_grammar "$@" "$grammar" > "$scratch/output" 2>&1
+        cmp -s "$scratch/output" "tests/outputs/$dir/${grammar##*/}" \
+            || echo "The output for $grammar with $* has changed"
+    done
+}
+
+compare_outputs by_components --by-components
+compare_outputs left_factor --left-factor
+
+compare_outputs ll1 --ll1 -v
+
+# Every line of tests/ll1/<name>.accept is in the language of <name>.txt
+# and no line of <name>.reject is. A grammar which is LL(1) must be
+# recognized by the predictive parser, and any other by the memoized one.
+# Left factoring changes the grammar but not its language.
+for grammar in tests/ll1/*.txt; do
+    name="${grammar%.txt}"
+    parser=predictive
+    grep -q "^The grammar is not LL(1)$" "tests/outputs/ll1/${grammar##*/}" \
+        && parser=memoized
+
+    for kind in accept reject; do
+        count="$(grep -c '' "$name.$kind")"
+        expected="$count accepted, 0 rejected"
+        [ "$kind" = reject ] && expected="0 accepted, $count rejected"
+
+        build/check_grammar -q --recognize "$name.$kind" "$grammar" 2>&1 \
+            | grep -q "with the $parser parser in .*: $expected$" \
+            || echo "The $parser parser did not $kind $name.$kind"
+        build/check_grammar -q --left-factor --recognize "$name.$kind" \
+                "$grammar" 2>&1 \
+            | grep -q ": $expected$" \
+            || echo "The left factored $grammar did not $kind $name.$kind"
+    done
 done